@@ -0,0 +1,683 @@
+#include "pubsub.h"
+#include "test/events.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <memory_resource>
+#include <random>
+#include <set>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Scaling benchmarks over the process/file events of test_example.cpp.  Run them through
+// `make bench`, which writes benchmarks.json for comparing runs.
+
+namespace
+{
+    using pid_t = int;
+
+    constexpr size_t eventCount = 4096; ///< Published events are drawn round robin from a pregenerated set
+    constexpr int fds = 64;
+
+    /// @brief A callback which counts its calls, whose signature is the given event
+    template<typename... Args>
+    struct Count
+    {
+        size_t* calls;
+        void operator()(Args...) const { ++*calls; }
+    };
+
+    template<typename Tuple>
+    struct CountFor;
+    template<typename... Args>
+    struct CountFor<std::tuple<Args...>>
+    {
+        using type = Count<Args...>;
+    };
+
+    /// @brief The first arity members of a tuple
+    template<size_t arity, typename Tuple>
+    auto Prefix(const Tuple& tuple)
+    {
+        return [&tuple]<size_t... index>(std::index_sequence<index...>)
+        { return std::make_tuple(std::get<index>(tuple)...); }(std::make_index_sequence<arity>{});
+    }
+
+    /// @brief Report the calls per published event and the event rate
+    void Report(benchmark::State& state, size_t calls)
+    {
+        state.counters["matches"] = benchmark::Counter(static_cast<double>(calls), benchmark::Counter::kAvgIterations);
+        state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+    }
+
+    /// @brief Publish FileOpen among subscriptions on distinct pids, with the given percentage of events matching one
+    void BM_Subscriptions(benchmark::State& state)
+    {
+        const auto subscriptions = static_cast<pid_t>(state.range(0));
+        const auto matchPercent = state.range(1);
+
+        size_t calls{};
+        tbd::PubSub pubsub;
+        auto anchor = pubsub.MakeAnchor();
+        for (pid_t pid{}; pid < subscriptions; ++pid)
+        {
+            anchor.Add(Count<Op, pid_t, int, How>{ &calls }, Op::FileOpen, pid);
+        }
+
+        std::mt19937 random{ 42U };
+        std::vector<pid_t> pids(eventCount);
+        for (auto& pid : pids)
+        {
+            auto value = static_cast<pid_t>(random() % static_cast<unsigned int>(subscriptions));
+            pid = static_cast<int64_t>(random() % 100U) < matchPercent ? value : subscriptions + value;
+        }
+
+        size_t next{};
+        for (auto _ : state)
+        {
+            pubsub.Publish(Op::FileOpen, pids[next++ % eventCount], 3, How::Read);
+        }
+        Report(state, calls);
+    }
+    BENCHMARK(BM_Subscriptions)
+        ->ArgNames({ "subscriptions", "matchPercent" })
+        ->ArgsProduct({ benchmark::CreateRange(1, 1'000'000, 10), { 0, 50, 100 } });
+
+    /// @brief Publish events of 1 to 6 arguments among 10k subscriptions with an exact condition on each argument
+    template<size_t arity>
+    void BM_Arity(benchmark::State& state)
+    {
+        constexpr int subscriptions = 10'000;
+        std::vector<std::string> paths{};
+        for (int i{}; i < 100; ++i)
+        {
+            paths.push_back("/usr/lib/file" + std::to_string(i));
+        }
+        const std::array<How, 3> hows{ How::Read, How::Write, How::Exec };
+        auto event = [&](int i)
+        {
+            // Op first, so that the pid only varies for arity 2 and above
+            return std::make_tuple(
+                Op::FileOpen,
+                pid_t{ i },
+                i % fds,
+                hows[static_cast<size_t>(i) % hows.size()],
+                std::string_view{ paths[static_cast<size_t>(i) % paths.size()] },
+                static_cast<uint64_t>(i) * 4096U);
+        };
+        using Event = decltype(Prefix<arity>(event(0)));
+
+        size_t calls{};
+        tbd::PubSub pubsub;
+        auto anchor = pubsub.MakeAnchor();
+        for (int i{}; i < (arity == 1 ? 1 : subscriptions); ++i)
+        {
+            std::apply(
+                [&](auto... args) { anchor.Add(typename CountFor<Event>::type{ &calls }, args...); },
+                Prefix<arity>(event(i)));
+        }
+
+        std::vector<Event> events{};
+        for (size_t i{}; i < eventCount; ++i)
+        {
+            events.push_back(Prefix<arity>(event(static_cast<int>(i * 7U) % subscriptions)));
+        }
+
+        size_t next{};
+        for (auto _ : state)
+        {
+            std::apply([&pubsub](const auto&... args) { pubsub.Publish(args...); }, events[next++ % eventCount]);
+        }
+        Report(state, calls);
+    }
+    BENCHMARK_TEMPLATE(BM_Arity, 1);
+    BENCHMARK_TEMPLATE(BM_Arity, 2);
+    BENCHMARK_TEMPLATE(BM_Arity, 3);
+    BENCHMARK_TEMPLATE(BM_Arity, 4);
+    BENCHMARK_TEMPLATE(BM_Arity, 5);
+    BENCHMARK_TEMPLATE(BM_Arity, 6);
+
+    enum class Modifier
+    {
+        Exact,
+        GE,
+        BitSelect,
+        Any,
+        Mixed,
+    };
+
+    /// @brief Publish FileOpen among 10k subscriptions whose fd and how conditions use the given modifier
+    void BM_Modifiers(benchmark::State& state)
+    {
+        constexpr int pids = 2'000;
+        constexpr int subscriptions = 10'000;
+        const auto modifier = static_cast<Modifier>(state.range(0));
+        constexpr std::array labels{ "exact", "GE", "BitSelect", "any", "mixed" };
+        state.SetLabel(labels[static_cast<size_t>(state.range(0))]);
+
+        size_t calls{};
+        tbd::PubSub pubsub;
+        auto anchor = pubsub.MakeAnchor();
+        Count<Op, pid_t, int, How> callback{ &calls };
+        for (int i{}; i < subscriptions; ++i)
+        {
+            const pid_t pid{ i % pids };
+            const int fd{ i % fds };
+            switch (modifier == Modifier::Mixed ? static_cast<Modifier>(i % 4) : modifier)
+            {
+            case Modifier::Exact:
+                anchor.Add(callback, Op::FileOpen, pid, fd, How::Write);
+                break;
+            case Modifier::GE:
+                anchor.Add(callback, Op::FileOpen, pid, tbd::GE{ fd }, How::Write);
+                break;
+            case Modifier::BitSelect:
+                anchor.Add(callback, Op::FileOpen, pid, fd, tbd::BitSelect<How, How::Write>{ How::Write });
+                break;
+            default:
+                anchor.Add(callback, Op::FileOpen, pid, tbd::any, tbd::any);
+                break;
+            }
+        }
+
+        std::mt19937 random{ 42U };
+        const std::array<How, 3> hows{ How::Read | How::Write, How::Write, How::Exec };
+        std::vector<std::tuple<pid_t, int, How>> events(eventCount);
+        for (auto& [pid, fd, how] : events)
+        {
+            pid = static_cast<pid_t>(random() % pids);
+            fd = static_cast<int>(random() % fds);
+            how = hows[random() % hows.size()];
+        }
+
+        size_t next{};
+        for (auto _ : state)
+        {
+            const auto& [pid, fd, how] = events[next++ % eventCount];
+            pubsub.Publish(Op::FileOpen, pid, fd, how);
+        }
+        Report(state, calls);
+    }
+    BENCHMARK(BM_Modifiers)->ArgName("modifier")->DenseRange(0, static_cast<int>(Modifier::Mixed));
+
+    /// @brief Subscriptions shared by the publisher threads of BM_PublisherThreads
+    struct Shared
+    {
+        std::atomic<size_t> calls{};
+        tbd::PubSub pubsub;
+        tbd::PubSub::Anchor anchor{ pubsub.MakeAnchor() };
+    };
+    std::unique_ptr<Shared> shared{};
+
+    /// @brief Publish FileClose from several threads at once among 10k subscriptions
+    void BM_PublisherThreads(benchmark::State& state)
+    {
+        constexpr pid_t subscriptions = 10'000;
+        if (state.thread_index() == 0)
+        {
+            shared = std::make_unique<Shared>();
+            for (pid_t pid{}; pid < subscriptions; ++pid)
+            {
+                shared->anchor.Add(
+                    [calls = &shared->calls](Op, pid_t, int) { calls->fetch_add(1U, std::memory_order_relaxed); },
+                    Op::FileClose,
+                    pid);
+            }
+        }
+
+        auto next = static_cast<size_t>(state.thread_index()) * 7919U;
+        for (auto _ : state)
+        {
+            shared->pubsub.Publish(Op::FileClose, static_cast<pid_t>(next++ % (2U * subscriptions)), 3);
+        }
+
+        state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+        if (state.thread_index() == 0)
+        {
+            // the counters of all threads are summed before averaging over their iterations
+            state.counters["matches"] =
+                benchmark::Counter(static_cast<double>(shared->calls.load()), benchmark::Counter::kAvgIterations);
+            shared.reset();
+        }
+    }
+    BENCHMARK(BM_PublisherThreads)->ThreadRange(1, 8)->UseRealTime();
+
+    /// @brief Publish among 10k subscriptions, replacing the oldest subscription once every so many events
+    void BM_Churn(benchmark::State& state)
+    {
+        constexpr pid_t pids = 10'000;
+        const auto eventsPerChurn = static_cast<size_t>(state.range(0));
+
+        size_t calls{};
+        tbd::PubSub pubsub;
+        Count<Op, pid_t, int, How, std::string_view> callback{ &calls };
+        std::deque<tbd::PubSub::Anchor> anchors{};
+        for (pid_t pid{}; pid < pids; ++pid)
+        {
+            anchors.push_back(pubsub.Subscribe(callback, Op::FileOpen, pid, tbd::any, How::Write));
+        }
+
+        size_t next{};
+        pid_t subscribed{ pids };
+        for (auto _ : state)
+        {
+            if (++next % eventsPerChurn == 0)
+            {
+                anchors.pop_front();
+                anchors.push_back(pubsub.Subscribe(callback, Op::FileOpen, subscribed++ % pids, tbd::any, How::Write));
+            }
+            pubsub.Publish(Op::FileOpen, static_cast<pid_t>(next * 7919U % pids), 3, How::Write, std::string_view{ "/tmp/file" });
+        }
+        Report(state, calls);
+    }
+    BENCHMARK(BM_Churn)->ArgName("eventsPerChurn")->RangeMultiplier(10)->Range(1, 10'000);
+} // namespace
+
+namespace
+{
+    constexpr pid_t chains = 100; ///< Processes followed at once by the chain benchmarks
+
+    /// @brief Count the processes which write a file and close it, with subscriptions made in callbacks as test_example.cpp does
+    tbd::PubSub::Anchor WatchWithCallbacks(tbd::PubSub& pubsub, pid_t pid, size_t* done)
+    {
+        auto anchor = pubsub.MakeAnchor();
+        anchor.Add(
+            [pubsub, done, anchors = pubsub.MakeAnchorage()](Op, pid_t pid, int fd, How, std::string_view) mutable
+            {
+                auto anchor = pubsub.MakeAnchor();
+                anchor.Add(
+                    [done, term = anchor.GetTerminator()](Op, pid_t, int)
+                    {
+                        ++*done;
+                        term.Terminate();
+                    },
+                    Op::FileClose,
+                    pid,
+                    fd);
+                anchors.push_back(std::move(anchor));
+            },
+            Op::FileOpen,
+            pid,
+            tbd::any,
+            tbd::BitSelect<How, How::Write>{ How::Write });
+        anchor.Add([term = anchor.GetTerminator()](Op, pid_t) { term.Terminate(); }, Op::ProcessEnd, pid);
+        return anchor;
+    }
+
+    /// @brief Count the processes which write a file and close it, awaiting each step in turn
+    tbd::PubSub::Chain WatchWithCoroutine(tbd::PubSub pubsub, pid_t pid, size_t* done)
+    {
+        auto [open, openPid, fd, how, path] = co_await pubsub.Next<Op, pid_t, int, How, std::string_view>(
+            Op::FileOpen, pid, tbd::any, tbd::BitSelect<How, How::Write>{ How::Write });
+        co_await pubsub.Next<Op, pid_t, int>(Op::FileClose, pid, fd);
+        ++*done;
+    }
+
+    /// @brief Follow 100 processes at a time through opening, closing and ending
+    template<typename Watch>
+    void Chains(benchmark::State& state, Watch watch)
+    {
+        size_t done{};
+        tbd::PubSub pubsub;
+        std::vector<decltype(watch(pubsub, pid_t{}, &done))> watches{};
+        for (auto _ : state)
+        {
+            for (pid_t pid{}; pid < chains; ++pid)
+            {
+                watches.push_back(watch(pubsub, pid, &done));
+            }
+            for (pid_t pid{}; pid < chains; ++pid)
+            {
+                pubsub.Publish(Op::FileOpen, pid, 3, How::Write, std::string_view{ "/tmp/file" });
+            }
+            for (pid_t pid{}; pid < chains; ++pid)
+            {
+                pubsub.Publish(Op::FileClose, pid, 3);
+            }
+            for (pid_t pid{}; pid < chains; ++pid)
+            {
+                pubsub.Publish(Op::ProcessEnd, pid);
+            }
+            watches.clear();
+        }
+        if (done != static_cast<size_t>(state.iterations()) * chains)
+        {
+            state.SkipWithError("a chain was not completed");
+        }
+        state.SetItemsProcessed(static_cast<int64_t>(done));
+    }
+
+    void BM_ChainCallbacks(benchmark::State& state)
+    {
+        Chains(state, WatchWithCallbacks);
+    }
+    BENCHMARK(BM_ChainCallbacks);
+
+    void BM_ChainCoroutine(benchmark::State& state)
+    {
+        Chains(state, WatchWithCoroutine);
+    }
+    BENCHMARK(BM_ChainCoroutine);
+} // namespace
+
+namespace
+{
+    /** @brief Follow processes which write a file and close it, with the given number in progress at once
+     *
+     * Each iteration takes one process through its file, and starts it again, so the
+     * number in progress stays the same.
+     */
+    template<typename Restart>
+    void Sequences(benchmark::State& state, tbd::PubSub& pubsub, const size_t& done, Restart restart)
+    {
+        const auto processes = static_cast<pid_t>(state.range(0));
+        for (pid_t pid{}; pid < processes; ++pid)
+        {
+            restart(pid);
+        }
+
+        size_t next{};
+        for (auto _ : state)
+        {
+            const auto pid = static_cast<pid_t>(next++ * 7919U % static_cast<size_t>(processes));
+            pubsub.Publish(Op::FileOpen, pid, 3, How::Write, std::string_view{ "/tmp/file" });
+            pubsub.Publish(Op::FileClose, pid, 3);
+            pubsub.Publish(Op::ProcessEnd, pid);
+            restart(pid);
+        }
+        if (done != static_cast<size_t>(state.iterations()))
+        {
+            state.SkipWithError("a sequence was not completed");
+        }
+        state.SetItemsProcessed(static_cast<int64_t>(done));
+    }
+
+    void BM_SequenceCallbacks(benchmark::State& state)
+    {
+        size_t done{};
+        tbd::PubSub pubsub;
+        std::vector<tbd::PubSub::Anchor> watches(static_cast<size_t>(state.range(0)));
+        Sequences(state, pubsub, done, [&](pid_t pid) { watches[static_cast<size_t>(pid)] = WatchWithCallbacks(pubsub, pid, &done); });
+    }
+    BENCHMARK(BM_SequenceCallbacks)->ArgName("inProgress")->Arg(1'000)->Arg(100'000);
+
+    void BM_SequencePattern(benchmark::State& state)
+    {
+        size_t done{};
+        tbd::PubSub pubsub;
+        constexpr tbd::Var<0> pid{};
+        constexpr tbd::Var<1> fd{};
+        auto sequence = pubsub.MakeSequence<pid_t, int>();
+        sequence.Then<Op, pid_t>(Op::ProcessStart, pid)
+            .Then<Op, pid_t, int, How, std::string_view>(Op::FileOpen, pid, fd, tbd::BitSelect<How, How::Write>{ How::Write })
+            .Then<Op, pid_t, int>(Op::FileClose, pid, fd);
+        auto anchor = sequence.Compile([&done](pid_t, int) { ++done; });
+        Sequences(state, pubsub, done, [&pubsub](pid_t pid) { pubsub.Publish(Op::ProcessStart, pid); });
+        state.counters["partialMatches"] = static_cast<double>(sequence.PartialMatches());
+    }
+    BENCHMARK(BM_SequencePattern)->ArgName("inProgress")->Arg(1'000)->Arg(100'000);
+} // namespace
+
+namespace
+{
+    /// @brief Subscribe the given number of anchors, each on its own int, and destroy them all again
+    void BM_SubscribeUnsubscribe(benchmark::State& state)
+    {
+        const auto subscriptions = static_cast<int>(state.range(0));
+        tbd::PubSub pubsub;
+        std::deque<tbd::PubSub::Anchor> anchors{};
+        for (auto _ : state)
+        {
+            for (int i{}; i < subscriptions; ++i)
+            {
+                anchors.push_back(pubsub.Subscribe([](int) {}, i));
+            }
+            anchors.clear();
+        }
+        state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * subscriptions);
+    }
+    BENCHMARK(BM_SubscribeUnsubscribe)->ArgName("subscriptions")->Arg(100'000)->Arg(1'000'000)->Unit(benchmark::kMillisecond);
+
+    /// @brief Comparable but not hashable, so its subscriptions go to an OrderedGroup
+    struct Version
+    {
+        int v;
+        auto operator<=>(const Version&) const = default;
+    };
+    using VersionTuple = tbd::helpers::ArgsToTuple<Version>;
+    using VersionSelect = std::tuple<const Version>;
+    inline auto versionCallback = [](Version) {};
+    using VersionElement = tbd::PubSub::Select<decltype(versionCallback), VersionSelect>;
+
+    /// @brief The multiset of element pointers which OrderedGroup used to be, for comparison
+    class TreeStore
+    {
+        struct Compare
+        {
+            using is_transparent = void;
+            bool operator()(const VersionElement* lhs, const VersionElement* rhs) const
+            {
+                return lhs->GetSelect() < rhs->GetSelect();
+            }
+            bool operator()(const VersionElement* lhs, const VersionTuple& rhs) const { return lhs->GetSelect() < rhs; }
+            bool operator()(const VersionTuple& lhs, const VersionElement* rhs) const { return lhs < rhs->GetSelect(); }
+        };
+        std::multiset<VersionElement*, Compare> set_{};
+
+    public:
+        void Insert(VersionElement* element) { set_.insert(element); }
+        size_t Match(const VersionTuple& args) const
+        {
+            auto [first, last] = set_.equal_range(args);
+            return static_cast<size_t>(std::distance(first, last));
+        }
+    };
+
+    class FlatStore
+    {
+        tbd::PubSub::OrderedGroup<VersionTuple, VersionSelect> group_{};
+
+    public:
+        void Insert(VersionElement* element) { group_.Insert(*element); }
+        size_t Match(const VersionTuple& args) const
+        {
+            tbd::PubSub::MatchResults<tbd::PubSub::ElementBase*> winners{};
+            group_.Match(&args, winners);
+            size_t count{};
+            for ([[maybe_unused]] auto winner : winners)
+            {
+                ++count;
+            }
+            return count;
+        }
+    };
+
+    /// @brief Version subscriptions with values drawn from [0, count], in a random order
+    std::vector<std::unique_ptr<VersionElement>> MakeVersions(size_t count, std::mt19937& random)
+    {
+        std::uniform_int_distribution<int> values{ 0, static_cast<int>(count) };
+        std::vector<std::unique_ptr<VersionElement>> elements{};
+        for (size_t i{}; i < count; ++i)
+        {
+            elements.emplace_back(
+                new (*std::pmr::new_delete_resource()) VersionElement{ versionCallback, Version{ values(random) } });
+        }
+        return elements;
+    }
+
+    /// @brief Match random versions in a store of the given number of subscriptions
+    template<typename Store>
+    void BM_OrderedStoreMatch(benchmark::State& state)
+    {
+        const auto subscriptions = static_cast<size_t>(state.range(0));
+        std::mt19937 random{ 42U };
+        auto elements = MakeVersions(subscriptions, random);
+        Store store{};
+        for (auto& element : elements)
+        {
+            store.Insert(element.get());
+        }
+
+        std::uniform_int_distribution<int> values{ 0, static_cast<int>(subscriptions) };
+        size_t matches{};
+        for (auto _ : state)
+        {
+            matches += store.Match(VersionTuple{ Version{ values(random) } });
+        }
+        Report(state, matches);
+    }
+    BENCHMARK_TEMPLATE(BM_OrderedStoreMatch, TreeStore)->ArgName("subscriptions")->Range(1'000, 1'000'000);
+    BENCHMARK_TEMPLATE(BM_OrderedStoreMatch, FlatStore)->ArgName("subscriptions")->Range(1'000, 1'000'000);
+
+    /// @brief Build a store of the given number of subscriptions, in a random order, as each run is built
+    template<typename Store>
+    void BM_OrderedStoreBuild(benchmark::State& state)
+    {
+        const auto subscriptions = static_cast<size_t>(state.range(0));
+        std::mt19937 random{ 42U };
+        auto elements = MakeVersions(subscriptions, random);
+        for (auto _ : state)
+        {
+            Store store{};
+            for (auto& element : elements)
+            {
+                store.Insert(element.get());
+            }
+        }
+        state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * subscriptions));
+    }
+    BENCHMARK_TEMPLATE(BM_OrderedStoreBuild, TreeStore)
+        ->ArgName("subscriptions")
+        ->Range(1'000, 1'000'000)
+        ->Unit(benchmark::kMillisecond);
+    BENCHMARK_TEMPLATE(BM_OrderedStoreBuild, FlatStore)
+        ->ArgName("subscriptions")
+        ->Range(1'000, 1'000'000)
+        ->Unit(benchmark::kMillisecond);
+} // namespace
+
+namespace
+{
+    /// @brief Subscribe, publish and unsubscribe over and over, allocating from new, the default pool or a given pool
+    void BM_SubscriptionChurn(benchmark::State& state)
+    {
+        constexpr std::array labels{ "operator new", "pool", "given pool" };
+        state.SetLabel(labels[static_cast<size_t>(state.range(0))]);
+        std::pmr::synchronized_pool_resource pool{};
+        tbd::PubSub pubsub = state.range(0) == 0 ? tbd::PubSub{ *std::pmr::new_delete_resource() }
+                             : state.range(0) == 1 ? tbd::PubSub{}
+                                                   : tbd::PubSub{ pool };
+        auto other = pubsub.Subscribe([](int) {}, 41);
+        size_t calls{};
+        for (auto _ : state)
+        {
+            auto anchor = pubsub.Subscribe([&calls](int) { ++calls; }, 42);
+            pubsub(42);
+        }
+        Report(state, calls);
+    }
+    BENCHMARK(BM_SubscriptionChurn)->ArgName("memory")->DenseRange(0, 2);
+
+    /// @brief Destroy 100k anchors, or detach them and wait for their removal in the background
+    void BM_AnchorTeardown(benchmark::State& state)
+    {
+        constexpr int anchors = 100'000;
+        const bool detach = state.range(0) != 0;
+        state.SetLabel(detach ? "DetachAsync" : "destroy");
+        tbd::PubSub pubsub{};
+        for (auto _ : state)
+        {
+            state.PauseTiming();
+            std::vector<tbd::PubSub::Anchor> all{};
+            for (int i{}; i < anchors; ++i)
+            {
+                all.push_back(pubsub.Subscribe([](int, int) {}, i % 100, i));
+            }
+            state.ResumeTiming();
+            if (detach)
+            {
+                std::atomic<int> remaining{ anchors };
+                for (auto& anchor : all)
+                {
+                    anchor.DetachAsync(
+                        [&remaining]
+                        {
+                            if (--remaining == 0)
+                            {
+                                remaining.notify_all();
+                            }
+                        });
+                }
+                for (auto left = remaining.load(); left != 0; left = remaining.load())
+                {
+                    remaining.wait(left);
+                }
+            }
+            all.clear();
+        }
+        state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * anchors);
+    }
+    BENCHMARK(BM_AnchorTeardown)->ArgName("detach")->DenseRange(0, 1)->Unit(benchmark::kMillisecond);
+
+    /// @brief Time each publish, with or without another thread subscribing and unsubscribing 64 at a time
+    void BM_PublishWhileChurning(benchmark::State& state)
+    {
+        const bool churning = state.range(0) != 0;
+        tbd::PubSub pubsub{};
+        auto anchor = pubsub.Subscribe([](int, int) {}, 42, 1);
+        std::atomic<size_t> cycles{};
+        std::jthread churn{};
+        if (churning)
+        {
+            churn = std::jthread{ [&pubsub, &cycles](std::stop_token stop)
+                                  {
+                                      while (!stop.stop_requested())
+                                      {
+                                          auto churned = pubsub.MakeAnchor();
+                                          for (int i{}; i < 64; ++i)
+                                          {
+                                              churned.Add([](int, int) {}, i, tbd::any);
+                                          }
+                                          ++cycles;
+                                      }
+                                  } };
+        }
+
+        std::vector<std::chrono::nanoseconds> latencies{};
+        for (auto _ : state)
+        {
+            auto start = std::chrono::steady_clock::now();
+            pubsub(42, 1);
+            latencies.push_back(std::chrono::steady_clock::now() - start);
+        }
+        churn = {};
+
+        std::ranges::sort(latencies);
+        auto percentile = [&latencies](double p)
+        {
+            const auto rank = static_cast<size_t>(p * static_cast<double>(latencies.size() - 1U));
+            return static_cast<double>(latencies[rank].count());
+        };
+        state.counters["p50ns"] = percentile(0.5);
+        state.counters["p99ns"] = percentile(0.99);
+        state.counters["p999ns"] = percentile(0.999);
+        state.counters["maxns"] = static_cast<double>(latencies.back().count());
+        state.counters["anchorsChurned"] = static_cast<double>(cycles.load());
+        state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+    }
+    BENCHMARK(BM_PublishWhileChurning)->ArgName("churning")->DenseRange(0, 1)->UseRealTime();
+} // namespace
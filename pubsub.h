@@ -2,15 +2,34 @@
 
 #include "demangle.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <bitset>
+#include <chrono>
+#include <concepts>
+#include <condition_variable>
+#include <coroutine>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <deque>
+#include <exception>
+#include <functional>
 #include <iomanip>
 #include <iostream>
+#include <iterator>
 #include <map>
 #include <memory>
+#include <memory_resource>
 #include <mutex>
+#include <new>
+#include <optional>
+#include <ranges>
 #include <set>
 #include <shared_mutex>
+#include <stdexcept>
 #include <thread>
 #include <tuple>
 #include <typeindex>
@@ -21,8 +40,17 @@
 #include <variant>
 #include <vector>
 
+/** Define TBD_PUBSUB_METRICS to count and time what each PubSub does; see PubSub::Metrics()
+ *
+ * Instrumented code is in a namespace of its own, so translation units built with
+ * and without it can be linked together.
+ */
 namespace tbd
 {
+#if defined(TBD_PUBSUB_METRICS)
+    inline namespace instrumented
+    {
+#endif
     template<typename Stream>
     concept Streamable = requires(Stream& s) {
         typename Stream::char_type;
@@ -45,7 +73,7 @@ namespace tbd
         // clang-format on
 
         template<typename Other>
-        friend constexpr bool operator==(const Any_t&, const Other& other)
+        friend constexpr bool operator==(const Any_t&, const Other&)
         {
             return true;
         }
@@ -59,6 +87,29 @@ namespace tbd
     };
     constexpr static Any_t any;
 
+    /** @brief A correlation variable of a PubSub::Sequence
+     *
+     * The first step to name a variable binds it to that argument, and later steps
+     * only match events whose argument has the bound value.  The index picks the
+     * variable's type from those the sequence is made with.
+     */
+    template<size_t index>
+    struct Var
+    {
+        static constexpr size_t value = index;
+    };
+
+    template<typename Type>
+    class LE;
+    template<typename Type>
+    class LT;
+    template<typename Type>
+    class GE;
+    template<typename Type>
+    class GT;
+    template<class Type, Type mask>
+    class BitSelect;
+
     namespace helpers
     {
         template<class T>
@@ -84,6 +135,26 @@ namespace tbd
         template<typename... Args>
         using ArgsToTuple = ::std::tuple<ArgToTuple_t<Args>...>;
 
+        inline ::std::atomic<size_t> nextSignatureId{};
+
+        /** @brief A small number identifying an argument tuple type, assigned on first use
+         *
+         * Unlike a type_index, it can index an array directly.
+         */
+        template<typename TupleType>
+        size_t SignatureId()
+        {
+            static const size_t id = nextSignatureId.fetch_add(1U, ::std::memory_order_relaxed);
+            return id;
+        }
+
+        /// @brief View a tuple of event values as the argument tuple Publish() would have made from them
+        template<typename... Args>
+        ArgsToTuple<Args...> AsArgTuple(const ::std::tuple<Args...>& values)
+        {
+            return ::std::apply([](const auto&... v) { return ArgsToTuple<Args...>{ v... }; }, values);
+        }
+
         template<typename NewType, typename PA, typename... TA>
         constexpr auto Extend(TA&&... args)
         {
@@ -150,696 +221,4419 @@ namespace tbd
 
         template<typename Lambda, typename... Args>
         using SelType = ExtendType<Any_t, GetTuple_t<Lambda>, const ::std::decay_t<Args>...>;
-    } // namespace helpers
 
-    class PubSub
-    {
-    public:
-        class Linker;
-        class Data;
-        class ElementBase;
+        template<typename Condition>
+        constexpr bool IsAny = ::std::is_same_v<::std::remove_cvref_t<Condition>, Any_t>;
+
+        /// @brief The bit of a correlation variable in a mask of them, or none for other conditions
+        template<typename Condition>
+        constexpr uint64_t VarBit = 0U;
+        template<size_t index>
+        constexpr uint64_t VarBit<Var<index>> = uint64_t{ 1U } << index;
+
+        template<typename Condition>
+        constexpr bool IsVar = VarBit<Condition> != 0U;
+
+        /// @brief The variables named by a tuple of conditions
+        template<typename Conditions>
+        constexpr uint64_t VarMask = 0U;
+        template<typename... Conditions>
+        constexpr uint64_t VarMask<::std::tuple<Conditions...>> = (VarBit<Conditions> | ... | 0U);
 
-        class ElementBaseCompare
+        /// @brief The condition to subscribe with, which is tbd::any in place of a variable
+        template<typename Condition>
+        const auto& Unbound(const Condition& condition)
         {
-        public:
-            using is_transparent = void;
-            bool operator()(const ::std::unique_ptr<ElementBase>& lhs, const ::std::unique_ptr<ElementBase>& rhs) const;
-            template<typename... Args>
-            bool operator()(const ::std::unique_ptr<ElementBase>& lhs, const ::std::tuple<Args...>& rhs) const;
-            template<typename... Args>
-            bool operator()(const ::std::tuple<Args...>& lhs, const ::std::unique_ptr<ElementBase>& rhs) const;
+            if constexpr (IsVar<Condition>)
+            {
+                return any;
+            }
+            else
+            {
+                return condition;
+            }
+        }
+
+        /** @brief Describes the comparison modifiers, which each select a range of values */
+        template<typename Condition>
+        struct RangeCondition
+        {
+            static constexpr bool isRange = false;
+        };
+        template<typename Type>
+        struct RangeCondition<GE<Type>>
+        {
+            static constexpr bool isRange = true;
+            static constexpr bool lower = true; ///< selects values above the bound
+            static constexpr bool inclusive = true;
+            using Value = Type;
+        };
+        template<typename Type>
+        struct RangeCondition<GT<Type>>
+        {
+            static constexpr bool isRange = true;
+            static constexpr bool lower = true;
+            static constexpr bool inclusive = false;
+            using Value = Type;
+        };
+        template<typename Type>
+        struct RangeCondition<LE<Type>>
+        {
+            static constexpr bool isRange = true;
+            static constexpr bool lower = false;
+            static constexpr bool inclusive = true;
+            using Value = Type;
+        };
+        template<typename Type>
+        struct RangeCondition<LT<Type>>
+        {
+            static constexpr bool isRange = true;
+            static constexpr bool lower = false;
+            static constexpr bool inclusive = false;
+            using Value = Type;
         };
 
-        /// @brief Elements with the same SelectType share the same set
-        using GroupSelector = ::std::multiset<::std::unique_ptr<ElementBase>, ElementBaseCompare>;
-        using ActiveThreads_t = ::std::unordered_set<::std::thread::id>;
-        using PerPrototype = ::std::unordered_map<::std::type_index, GroupSelector>;
-        using Database_t = ::std::unordered_map<::std::type_index, PerPrototype>;
+        template<typename Condition>
+        constexpr bool IsRange = RangeCondition<::std::remove_cvref_t<Condition>>::isRange;
 
-        class ElementBase
+        /** @brief A range condition whose bound can be kept in order alongside the published values */
+        template<typename Condition, typename Arg>
+        concept IndexedRange = IsRange<Condition> &&
+            ::std::is_same_v<typename RangeCondition<::std::remove_cvref_t<Condition>>::Value, ::std::remove_cvref_t<Arg>> &&
+            ::std::totally_ordered<::std::remove_cvref_t<Arg>>;
+
+        /** @brief Describes BitSelect<>, which selects the values having particular bits under a mask */
+        template<typename Condition>
+        struct BitCondition
         {
-            ::std::weak_ptr<Linker> linker_{};
-            GroupSelector::iterator next_{};
-            GroupSelector* selectors_{};
+            static constexpr bool isBits = false;
+        };
+        template<typename Type, Type bitMask>
+        struct BitCondition<BitSelect<Type, bitMask>>
+        {
+            static constexpr bool isBits = true;
+            static constexpr Type mask = bitMask;
+            using Value = Type;
+        };
 
-            friend class Linker;
-            friend class Data;
+        template<typename Condition>
+        constexpr bool IsBits = BitCondition<::std::remove_cvref_t<Condition>>::isBits;
 
-        public:
-            ::std::weak_ptr<Linker> GetLinker() const { return linker_; }
-            virtual ~ElementBase(){};
-            virtual void* GetFunc() = 0;
-            virtual void Execute(const void* args) = 0;
-            virtual ::std::weak_ordering Compare(const ElementBase* candidate) const = 0;
-            virtual ::std::weak_ordering Compare(const void* candidate) const = 0;
-            virtual ::std::unique_ptr<ElementBase> MakeUnique() = 0;
+        template<typename Type>
+        concept Hashable = requires(const Type& value) {
+            { ::std::hash<Type>{}(value) } -> ::std::convertible_to<size_t>;
+        };
 
-            // virtual std::type_index ReturnType() const = 0;
-            virtual ::std::type_index ArgumentType() const = 0;
-            virtual ::std::type_index SelectArgs() const = 0;
+        /** @brief A condition which can be found by hashing the published value
+         *
+         * It must have the same type as the argument, so that both hash alike.  A
+         * BitSelect<> hashes its bits, and the argument hashes the same bits of its value.
+         */
+        template<typename Condition, typename Arg>
+        concept HashableCondition = IsAny<Condition> ||
+            (::std::is_same_v<::std::remove_cvref_t<Condition>, ::std::remove_cvref_t<Arg>> &&
+             Hashable<::std::remove_cvref_t<Condition>>) ||
+            (IsBits<Condition> &&
+             ::std::is_same_v<typename BitCondition<::std::remove_cvref_t<Condition>>::Value, ::std::remove_cvref_t<Arg>> &&
+             Hashable<::std::remove_cvref_t<Arg>>);
+
+        template<typename TupleType, typename SelectType, typename Seq = ::std::make_index_sequence<::std::tuple_size_v<TupleType>>>
+        constexpr bool HashableSelect = false;
+        template<typename TupleType, typename SelectType, size_t... I>
+            requires(::std::tuple_size_v<TupleType> == ::std::tuple_size_v<SelectType>)
+        constexpr bool HashableSelect<TupleType, SelectType, ::std::index_sequence<I...>> =
+            (HashableCondition<::std::tuple_element_t<I, SelectType>, ::std::tuple_element_t<I, TupleType>> && ...);
+
+        /// @brief Selectors with a single range condition, and otherwise only what HashableSelect allows
+        template<typename TupleType, typename SelectType, typename Seq = ::std::make_index_sequence<::std::tuple_size_v<TupleType>>>
+        constexpr bool IntervalSelect = false;
+        template<typename TupleType, typename SelectType, size_t... I>
+            requires(::std::tuple_size_v<TupleType> == ::std::tuple_size_v<SelectType>)
+        constexpr bool IntervalSelect<TupleType, SelectType, ::std::index_sequence<I...>> =
+            ((HashableCondition<::std::tuple_element_t<I, SelectType>, ::std::tuple_element_t<I, TupleType>> ||
+              IndexedRange<::std::tuple_element_t<I, SelectType>, ::std::tuple_element_t<I, TupleType>>) &&
+             ...) &&
+            (size_t{ IsRange<::std::tuple_element_t<I, SelectType>> } + ... + 0) == 1;
 
+        template<typename SelectType, size_t... I>
+        constexpr size_t FindRangeSlot(::std::index_sequence<I...>)
+        {
+            size_t slot{ sizeof...(I) };
+            ((slot = IsRange<::std::tuple_element_t<I, SelectType>> ? I : slot), ...);
+            return slot;
+        }
+        template<typename SelectType>
+        constexpr size_t RangeSlot = FindRangeSlot<SelectType>(::std::make_index_sequence<::std::tuple_size_v<SelectType>>{});
+
+        /// @brief Integers and enums, any condition on which can be encoded as bounds on a machine word
+        template<typename Type>
+        concept Scalar = ::std::is_integral_v<Type> || ::std::is_enum_v<Type>;
+
+        template<typename Condition, typename Arg>
+        concept ScalarCondition = Scalar<::std::remove_cvref_t<Arg>> &&
+            (IsAny<Condition> || ::std::is_same_v<::std::remove_cvref_t<Condition>, ::std::remove_cvref_t<Arg>> ||
+             IndexedRange<Condition, Arg> ||
+             (IsBits<Condition> &&
+              ::std::is_same_v<typename BitCondition<::std::remove_cvref_t<Condition>>::Value, ::std::remove_cvref_t<Arg>>));
+
+        /// @brief Selectors of scalar conditions which neither hashing nor a single interval can index
+        template<typename TupleType, typename SelectType, typename Seq = ::std::make_index_sequence<::std::tuple_size_v<TupleType>>>
+        constexpr bool ColumnarSelect = false;
+        template<typename TupleType, typename SelectType, size_t... I>
+            requires(::std::tuple_size_v<TupleType> == ::std::tuple_size_v<SelectType>)
+        constexpr bool ColumnarSelect<TupleType, SelectType, ::std::index_sequence<I...>> =
+            (ScalarCondition<::std::tuple_element_t<I, SelectType>, ::std::tuple_element_t<I, TupleType>> && ...) &&
+            !HashableSelect<TupleType, SelectType> && !IntervalSelect<TupleType, SelectType>;
+
+        /// @brief The narrowest word which holds every argument of the tuple
+        template<typename TupleType, typename Seq = ::std::make_index_sequence<::std::tuple_size_v<TupleType>>>
+        struct ScalarWordFor;
+        template<typename TupleType, size_t... I>
+        struct ScalarWordFor<TupleType, ::std::index_sequence<I...>>
+        {
+            using type = ::std::conditional_t<
+                ((sizeof(::std::remove_cvref_t<::std::tuple_element_t<I, TupleType>>) <= sizeof(uint32_t)) && ...),
+                uint32_t,
+                uint64_t>;
         };
+        template<typename TupleType>
+        using ScalarWord = typename ScalarWordFor<TupleType>::type;
 
-        class Linker
+        /// @brief Whether the target compares vectors of 64 bit lanes natively
+#if defined(__SSE4_2__) || defined(__aarch64__)
+        constexpr bool wideVectorCompare = true;
+#else
+        constexpr bool wideVectorCompare = false;
+#endif
+
+        /// @brief Whether PubSub keeps metrics, which otherwise compile to nothing
+#if defined(TBD_PUBSUB_METRICS)
+        constexpr bool metrics = true;
+#else
+        constexpr bool metrics = false;
+#endif
+
+        /// @brief The bits of a scalar, sign extended to the word
+        template<typename Word, Scalar Type>
+        constexpr Word ScalarBits(Type value)
         {
-            ::std::deque<::std::pair<GroupSelector*, GroupSelector::iterator>> entries_{};
-            ::std::mutex activeLock_{};
-            ::std::shared_mutex sharedLock_{};
-            ActiveThreads_t active_{};
-            ::std::thread::id activeSolo_{};
-            ::std::weak_ptr<Data> data_{};
-            ElementBase* mostRecent_{};
+            if constexpr (::std::is_enum_v<Type>)
+            {
+                return ScalarBits<Word>(static_cast<::std::underlying_type_t<Type>>(value));
+            }
+            else if constexpr (::std::is_signed_v<Type>)
+            {
+                return static_cast<Word>(static_cast<::std::make_signed_t<Word>>(value));
+            }
+            else
+            {
+                return static_cast<Word>(value);
+            }
+        }
 
-        public:
-            Linker(::std::weak_ptr<Data> data) : data_{ ::std::move(data) } {}
-            ~Linker() { Destroy(); }
-            Linker(Linker&&) = delete;
+        /// @brief Flipping the sign bit of signed values makes their bits order as the values do
+        template<typename Word, Scalar Type>
+        constexpr Word scalarFlip = ::std::is_signed_v<Type> ? Word{ 1U } << (sizeof(Word) * 8U - 1U) : 0U;
+        template<typename Word, Scalar Type>
+            requires ::std::is_enum_v<Type>
+        constexpr Word scalarFlip<Word, Type> = scalarFlip<Word, ::std::underlying_type_t<Type>>;
+
+        template<typename Word, Scalar Type>
+        constexpr Word OrderedBits(Type value)
+        {
+            return ScalarBits<Word>(value) ^ scalarFlip<Word, Type>;
+        }
+
+        /** @brief A condition on one scalar slot
+         *
+         * It matches the values whose ordered bits, under the mask, lie between low and
+         * low + span.  Both sides are unsigned, so the test is the single comparison
+         * `((bits & mask) - low) <= span`.
+         */
+        template<typename Word>
+        struct ScalarBound
+        {
+            Word low;
+            Word span;
+            Word mask;
+        };
 
-            static void Remember(::std::shared_ptr<Linker> self, GroupSelector& selectors, GroupSelector::iterator it)
+        template<typename Word, typename Arg, typename Condition>
+        constexpr ScalarBound<Word> MakeScalarBound(const Condition& condition)
+        {
+            constexpr Word all = ~Word{};
+            constexpr ScalarBound<Word> never{ 1U, 0U, 0U };
+            if constexpr (IsAny<Condition>)
             {
-                auto previous = ::std::exchange(self->mostRecent_, it->get());
-                GroupSelector::iterator next{ previous ? ::std::exchange(previous->next_, it) : it};
-                ElementBase& element = **it;
-                element.next_ = next;
-                element.linker_ = self;
-                element.selectors_ = &selectors;
+                return { 0U, all, 0U };
             }
-            explicit operator bool() const { return mostRecent_; }
-            size_t size() const { return entries_.size(); }
-            ::std::weak_ptr<Data> GetData() { return data_; }
-            void Destroy()
+            else if constexpr (IsBits<Condition>)
             {
-                auto last = ::std::exchange(mostRecent_, nullptr);
-                if (!last)
-                {
-                    return;
-                }
+                const auto mask = ScalarBits<Word>(BitCondition<Condition>::mask);
+                return { static_cast<Word>(OrderedBits<Word>(static_cast<Arg>(condition)) & mask), 0U, mask };
+            }
+            else if constexpr (IsRange<Condition>)
+            {
+                using Range = RangeCondition<Condition>;
+                const auto bound = OrderedBits<Word>(condition.Value());
+                if constexpr (Range::lower)
                 {
-                    ::std::scoped_lock<::std::mutex> activeGuard{ activeLock_ };
-                    const auto thisThread = ::std::this_thread::get_id();
-                    if (active_.empty())
-                    {
-                        if (activeSolo_ == thisThread)
-                        {
-                            activeSolo_ = {};
-                            sharedLock_.unlock_shared();
-                        }
-                    }
-                    else
+                    if (!Range::inclusive && bound == all)
                     {
-                        if (auto it = active_.find(thisThread); it != active_.end())
-                        {
-                            active_.erase(it);
-                            sharedLock_.unlock_shared();
-                        }
+                        return never;
                     }
+                    const Word low = Range::inclusive ? bound : bound + 1U;
+                    return { low, static_cast<Word>(all - low), all };
                 }
-                ::std::scoped_lock<::std::shared_mutex> guard{ sharedLock_ };
-                if (auto data = data_.lock())
+                else
                 {
-                    data->ReleaseNodes(*last);
+                    if (!Range::inclusive && bound == 0U)
+                    {
+                        return never;
+                    }
+                    return { 0U, Range::inclusive ? bound : static_cast<Word>(bound - 1U), all };
                 }
             }
-            bool Mark()
+            else
+            {
+                return { OrderedBits<Word>(condition), 0U, all };
+            }
+        }
+
+        /// @brief Hashable selectors of exact conditions and tbd::any, without BitSelect<>
+        template<typename TupleType, typename SelectType, typename Seq = ::std::make_index_sequence<::std::tuple_size_v<TupleType>>>
+        constexpr bool DiscriminationSelect = false;
+        template<typename TupleType, typename SelectType, size_t... I>
+            requires(::std::tuple_size_v<TupleType> == ::std::tuple_size_v<SelectType>)
+        constexpr bool DiscriminationSelect<TupleType, SelectType, ::std::index_sequence<I...>> =
+            HashableSelect<TupleType, SelectType> && !(IsBits<::std::tuple_element_t<I, SelectType>> || ...);
+
+        /// @brief Whether a value is its own discrimination key, so that equal keys mean equal values
+        template<typename Type>
+        constexpr bool exactDiscriminationKey = Scalar<Type> && sizeof(Type) <= sizeof(size_t);
+
+        /// @brief The key by which a DiscriminationGroup branches on a value
+        template<typename Type>
+        size_t DiscriminationKey(const Type& value)
+        {
+            if constexpr (exactDiscriminationKey<Type>)
+            {
+                return static_cast<size_t>(ScalarBits<uint64_t>(value));
+            }
+            else if constexpr (Hashable<Type>)
+            {
+                return ::std::hash<Type>{}(value);
+            }
+            else
             {
+                return 0U; // only tbd::any can select a value which can't be hashed
+            }
+        }
+
+        /// @brief The part of a condition which is found by hashing, or tbd::any where there is none
+        template<typename Condition>
+        using KeyCondition = ::std::
+            conditional_t<IsAny<Condition> || IsRange<Condition>, Any_t, ::std::remove_cvref_t<Condition>>;
+
+        template<typename SelectType>
+        struct SelectKeyFor;
+        template<typename... Conditions>
+        struct SelectKeyFor<::std::tuple<Conditions...>>
+        {
+            using Type = ::std::tuple<KeyCondition<Conditions>...>;
+        };
+        template<typename SelectType>
+        using SelectKey = typename SelectKeyFor<SelectType>::Type;
+
+        template<typename SelectType>
+        struct MutableTupleFor;
+        template<typename... Conditions>
+        struct MutableTupleFor<::std::tuple<Conditions...>>
+        {
+            using Type = ::std::tuple<::std::remove_cvref_t<Conditions>...>;
+        };
+        /// @brief A copy of the conditions which, unlike the SelectType, can be assigned
+        template<typename SelectType>
+        using MutableTuple = typename MutableTupleFor<SelectType>::Type;
+
+        template<typename SelectType>
+        SelectKey<SelectType> MakeSelectKey(const SelectType& sel)
+        {
+            return ::std::apply(
+                [](const auto&... conditions)
                 {
-                    const auto thisThread = ::std::this_thread::get_id();
-                    ::std::scoped_lock<::std::mutex> activeGuard{ activeLock_ };
-                    if (active_.empty())
-                    {
-                        if (activeSolo_ == ::std::thread::id{})
-                        {
-                            activeSolo_ = thisThread;
-                        }
-                        else if (activeSolo_ == thisThread)
-                        {
-                            return false;
-                        }
-                        else
-                        {
-                            active_.emplace(activeSolo_);
-                            active_.emplace(thisThread);
-                            activeSolo_ = {};
-                        }
-                        sharedLock_.lock_shared();
-                        return true;
-                    }
+                    return SelectKey<SelectType>{ [](const auto& condition) -> KeyCondition<decltype(condition)>
+                                                  {
+                                                      if constexpr (::std::is_same_v<KeyCondition<decltype(condition)>, Any_t>)
+                                                      {
+                                                          return {};
+                                                      }
+                                                      else
+                                                      {
+                                                          return condition;
+                                                      }
+                                                  }(conditions)... };
+                },
+                sel);
+        }
 
-                    auto p = active_.emplace(thisThread);
-                    if (!p.second)
-                    {
-                        return false;
-                    }
-                }
-                sharedLock_.lock_shared();
-                return true;
+        /** @brief Hash of a tuple's values, skipping the slots where SelectType has no condition
+         *
+         * Works on the SelectType itself, and on the published tuple of arguments.
+         */
+        template<typename SelectType>
+        struct SelectHash
+        {
+            using is_transparent = void;
+
+            template<typename Tuple>
+            size_t operator()(const Tuple& values) const
+            {
+                return Combine(values, ::std::make_index_sequence<::std::tuple_size_v<SelectType>>{});
             }
 
-            void Unmark()
+        private:
+            template<typename Tuple, size_t... I>
+            static size_t Combine(const Tuple& values, ::std::index_sequence<I...>)
+            {
+                size_t result{};
+                (Add<I>(result, values), ...);
+                return result;
+            }
+            template<size_t I, typename Tuple>
+            static void Add(size_t& result, const Tuple& values)
             {
+                using Condition = KeyCondition<::std::tuple_element_t<I, SelectType>>;
+                if constexpr (IsBits<Condition>)
                 {
-                    ::std::scoped_lock<::std::mutex> activeGuard{ activeLock_ };
-                    if (active_.empty())
+                    using Bits = BitCondition<Condition>;
+                    const auto& value = ::std::get<I>(values);
+                    if constexpr (::std::is_same_v<::std::remove_cvref_t<decltype(value)>, Condition>)
                     {
-                        if (activeSolo_ != ::std::this_thread::get_id())
-                        {
-                            return;
-                        }
-                        activeSolo_ = {};
+                        Mix(result, ::std::hash<typename Bits::Value>{}(static_cast<typename Bits::Value>(value)));
                     }
-                    else if (active_.erase(::std::this_thread::get_id()) == 0)
+                    else
                     {
-                        return;
+                        Mix(result, ::std::hash<typename Bits::Value>{}(static_cast<typename Bits::Value>(value & Bits::mask)));
                     }
                 }
-                sharedLock_.unlock_shared();
-            }
-
-            class Guard
-            {
-                ::std::weak_ptr<Linker> linker_{};
-                bool claimed_{};
-
-            public:
-                Guard(::std::shared_ptr<Linker> linker) : linker_{ linker }, claimed_{ linker->Mark() } {}
-
-                ~Guard()
+                else if constexpr (!IsAny<Condition>)
                 {
-                    if (claimed_)
-                    {
-                        if (auto linker = linker_.lock())
-                        {
-                            linker->Unmark();
-                        }
-                    }
+                    Mix(result, ::std::hash<Condition>{}(::std::get<I>(values)));
                 }
-            };
-            static Guard Protect(::std::shared_ptr<Linker> linker) { return Guard{ ::std::move(linker) }; }
+            }
+            static void Mix(size_t& result, size_t hash)
+            {
+                result ^= hash + 0x9e3779b97f4a7c15ULL + (result << 6) + (result >> 2);
+            }
         };
 
-        template <class Type>
-        class MatchResults
+        struct TupleEqual
         {
-            size_t size_{};
-            union
+            using is_transparent = void;
+            template<typename Lhs, typename Rhs>
+            bool operator()(const Lhs& lhs, const Rhs& rhs) const
             {
-                Type short_[1];
-                ::std::deque<Type> long_;
-            };
-            using Short = decltype(short_);
-            using Long = decltype(long_);
+                return lhs == rhs;
+            }
+        };
+    } // namespace helpers
 
-            constexpr inline static size_t maxShort = sizeof(short_) / sizeof(short_[0]);
+    class PubSub
+    {
+    public:
+        class Linker;
+        class Data;
+        class ElementBase;
+        class Runs;
+
+        class GroupBase;
+        template<typename TupleType, typename SelectType>
+        class Selection;
+        template<typename TupleType, typename SelectType>
+        class OrderedGroup;
+        template<typename TupleType, typename SelectType>
+        class HashedGroup;
+        template<typename TupleType>
+        class ColumnarGroup;
+        template<typename TupleType>
+        class DiscriminationGroup;
+        template<typename TupleType>
+        struct DiscriminationNode;
+
+        /** @brief Counts spread over slots for each thread, which are only added up when read
+         *
+         * A slot's counters are allocated by the first thread to use it.
+         */
+        template<typename Counters>
+        class PerThread
+        {
+            static constexpr size_t slotCount = 64;
+            mutable ::std::array<::std::atomic<Counters*>, slotCount> slots_{};
 
         public:
-            MatchResults() {}
-            MatchResults(MatchResults&& donor) noexcept : size_{ donor.size_ }
+            PerThread() = default;
+            PerThread(PerThread&&) = delete;
+            ~PerThread()
             {
-                if (size_ <= maxShort)
-                {
-                    for (size_t i = 0 ; i < size_ ; ++i)
-                    {
-                        new (&short_[i]) Type {::std::move(donor.short_[i])};
-                        donor.short_[i].~Type();
-                    }
-                }
-                else
+                for (auto& slot : slots_)
                 {
-                    new (&long_) Long{::std::move(donor.long_)};
-                    donor.long_.~Long();
+                    delete slot.load(::std::memory_order_relaxed);
                 }
             }
-            ~MatchResults()
+            Counters& Local() const
             {
-                if (size_ <= maxShort)
+                auto& slot = slots_[ThreadSlots::Get() % slotCount];
+                auto counters = slot.load(::std::memory_order_acquire);
+                if (!counters)
                 {
-                    for (size_t i = 0 ; i < size_; ++i)
+                    auto made = new Counters{};
+                    if (slot.compare_exchange_strong(counters, made, ::std::memory_order_acq_rel))
                     {
-                        short_[i].~Type();
+                        counters = made;
+                    }
+                    else
+                    {
+                        delete made;
                     }
                 }
-                else
-                {
-                    long_.~Long();
-                }
+                return *counters;
             }
-            void push_back(Type t)
+            template<typename Visitor>
+            void ForEach(Visitor&& visitor) const
             {
-                if (size_ < maxShort)
+                for (auto& slot : slots_)
                 {
-                    new (&short_[size_++]) Type{ ::std::move(t) };
-                }
-                else if (size_ == maxShort)
-                {
-                    ++size_;
-                    ::std::deque<Type> d{};
-                    for (auto& x : short_)
+                    if (auto counters = slot.load(::std::memory_order_acquire))
                     {
-                        d.push_back(::std::move(x));
-                        x.~Type();
+                        visitor(static_cast<const Counters&>(*counters));
                     }
-                    d.push_back(::std::move(t));
-                    new (&long_) Long{ ::std::move(d) };
-                }
-                else {
-                    ++size_;
-                    long_.push_back(::std::move(t));
                 }
             }
-            class const_iterator
-            {
-                friend class MatchResults;
-                using ItShort = const Type*;
-                using ItLong = typename MatchResults::Long::const_iterator;
-                using ItType = ::std::variant<ItShort, ItLong>;
+        };
 
-                ItType iterator_{ItShort{}};
+        /** @brief Nanosecond latencies in log-linear buckets, four to each power of two, like an HDR histogram */
+        class Histogram
+        {
+        public:
+            static constexpr size_t buckets = 256;
 
-                const_iterator(ItType it) : iterator_{it} {}
-            public:
-                const_iterator() {}
-                // clang-format off
-                friend auto operator<=>(const const_iterator& lhs, const const_iterator& rhs) = default;
-                // clang-format on
-                const_iterator& operator++()
+            static size_t Bucket(uint64_t ns)
+            {
+                if (ns < 4U)
                 {
-                    ::std::visit([](auto&& it) { ++it; }, iterator_);
-                    return *this;
+                    return ns;
                 }
-                const Type& operator*() const
+                auto exponent = static_cast<size_t>(::std::bit_width(ns)) - 1U;
+                return (exponent - 1U) * 4U + ((ns >> (exponent - 2U)) & 3U);
+            }
+            /// @brief The highest latency which falls in a bucket
+            static uint64_t Highest(size_t bucket)
+            {
+                if (bucket < 4U)
+                {
+                    return bucket;
+                }
+                auto exponent = bucket / 4U + 1U;
+                return ((4U + bucket % 4U + 1U) << (exponent - 2U)) - 1U;
+            }
+
+            void Record(uint64_t ns) { counts_[Bucket(ns)].fetch_add(1U, ::std::memory_order_relaxed); }
+            template<typename Counts>
+            void AddTo(Counts& counts) const
+            {
+                for (size_t bucket{}; bucket < buckets; ++bucket)
+                {
+                    counts[bucket] += counts_[bucket].load(::std::memory_order_relaxed);
+                }
+            }
+
+        private:
+            ::std::array<::std::atomic<uint64_t>, buckets> counts_{};
+        };
+
+        /** @brief A copy of some metrics, as returned by PubSub::Metrics() */
+        struct MetricsSnapshot
+        {
+            struct Latencies
+            {
+                ::std::array<uint64_t, Histogram::buckets> counts{};
+
+                uint64_t Count() const
                 {
-                    // return std::visit([](auto&& it) { return *it; }, iterator_);
-                    if (::std::holds_alternative<ItShort>(iterator_))
+                    uint64_t result{};
+                    for (auto count : counts)
                     {
-                        return *::std::get<ItShort>(iterator_);
+                        result += count;
                     }
-                    else
+                    return result;
+                }
+                /// @brief The latency in nanoseconds within which the given fraction of samples fell
+                uint64_t Percentile(double fraction) const
+                {
+                    auto rank = static_cast<uint64_t>(fraction * static_cast<double>(Count()));
+                    uint64_t seen{};
+                    for (size_t bucket{}; bucket < counts.size(); ++bucket)
+                    {
+                        seen += counts[bucket];
+                        if (counts[bucket] != 0U && seen > rank)
+                        {
+                            return Histogram::Highest(bucket);
+                        }
+                    }
+                    return Max();
+                }
+                uint64_t Max() const
+                {
+                    for (auto bucket = counts.size(); bucket > 0U; --bucket)
                     {
-                        return *::std::get<ItLong>(iterator_);
+                        if (counts[bucket - 1U] != 0U)
+                        {
+                            return Histogram::Highest(bucket - 1U);
+                        }
                     }
+                    return 0U;
                 }
             };
-            const_iterator begin() const {
-                using ItType = const_iterator::ItType;
-                return const_iterator{size_ <= maxShort ? ItType{::std::begin(short_)} : ItType{::std::begin(long_)}};
+            struct Group
+            {
+                ::std::type_index group;
+                Latencies execute{}; ///< time spent in each callback of the group
+            };
+            struct Signature
+            {
+                ::std::type_index signature;
+                uint64_t publishes{};
+                uint64_t matched{};   ///< publishes which matched at least one subscription
+                uint64_t unmatched{};
+                Latencies match{}; ///< time spent finding the matches of each publish
+                ::std::vector<Group> groups{};
+            };
+
+            ::std::vector<Signature> signatures{};
+            uint64_t writerWaits{}; ///< writers which had to wait for the writers' lock; publishers never wait
+            uint64_t linkerWaits{}; ///< unsubscribes which had to wait for callbacks in progress
+
+            template<Streamable Stream>
+            friend Stream& operator<<(Stream& stream, const MetricsSnapshot& m)
+            {
+                auto latencies = [&stream](const char* name, const Latencies& l)
+                {
+                    stream << " " << name << " p50 " << l.Percentile(0.5) << "ns p99 " << l.Percentile(0.99)
+                           << "ns p99.9 " << l.Percentile(0.999) << "ns max " << l.Max() << "ns";
+                };
+                stream << "\n  waits: writer " << m.writerWaits << ", linker " << m.linkerWaits;
+                for (const auto& signature : m.signatures)
+                {
+                    stream << "\n  " << ShowTupleArgs(signature.signature) << ": " << signature.publishes
+                           << " published, " << signature.matched << " matched, " << signature.unmatched << " unmatched,";
+                    latencies("match", signature.match);
+                    for (const auto& group : signature.groups)
+                    {
+                        stream << "\n    " << ShowTupleArgs(group.group) << ":";
+                        latencies("execute", group.execute);
+                    }
+                }
+                return stream;
             }
-            const_iterator end() const {
-                using ItType = const_iterator::ItType;
-                return const_iterator{size_ <= maxShort ? ItType{::std::begin(short_) + size_} : ItType{::std::end(long_)}};
+        };
+
+        /// @brief Stands in for a counter or a timer when metrics are disabled
+        struct NoMetric
+        {
+            void Add(uint64_t) {}
+            uint64_t Load() const { return 0U; }
+            void Record(uint64_t) {}
+            void Record(uint64_t, bool) {}
+            uint64_t Elapsed() const { return 0U; }
+            template<typename Snapshot>
+            void AddTo(Snapshot&) const
+            {
             }
         };
 
-        /** Simpler, non-movable variant of std::shared_lock<> */
-        template <class Lock>
-        class SharedGuard
+        class CounterMetric
         {
-            Lock& lock_{};
+            PerThread<::std::atomic<uint64_t>> counts_{};
+
         public:
-            SharedGuard(Lock& lock) : lock_{lock} { lock.lock_shared(); }
-            ~SharedGuard() { lock_.unlock_shared(); }
-            SharedGuard(SharedGuard&&) = delete;
+            void Add(uint64_t count) { counts_.Local().fetch_add(count, ::std::memory_order_relaxed); }
+            uint64_t Load() const
+            {
+                uint64_t result{};
+                counts_.ForEach([&result](const ::std::atomic<uint64_t>& count) { result += count.load(::std::memory_order_relaxed); });
+                return result;
+            }
         };
 
+        class StopwatchMetric
+        {
+            ::std::chrono::steady_clock::time_point start_{ ::std::chrono::steady_clock::now() };
 
-        class Term
+        public:
+            uint64_t Elapsed() const
+            {
+                return static_cast<uint64_t>(
+                    ::std::chrono::duration_cast<::std::chrono::nanoseconds>(::std::chrono::steady_clock::now() - start_)
+                        .count());
+            }
+        };
+
+        /// @brief How long the callbacks of a group take
+        class GroupMetric
         {
-            ::std::weak_ptr<Linker> linker_{};
+            PerThread<Histogram> execute_{};
 
         public:
-            Term() = default;
-            Term(::std::weak_ptr<Linker> linker) : linker_{ ::std::move(linker) } {}
+            void Record(uint64_t ns) { execute_.Local().Record(ns); }
+            void AddTo(MetricsSnapshot::Latencies& latencies) const
+            {
+                execute_.ForEach([&latencies](const Histogram& h) { h.AddTo(latencies.counts); });
+            }
+        };
 
-            void Terminate() const
+        /// @brief What publishing a call signature has found, and how long it took
+        class PrototypeMetric
+        {
+            struct Counters
             {
-                if (auto linker = linker_.lock())
-                {
-                    linker->Destroy();
-                }
+                ::std::atomic<uint64_t> matched{};
+                ::std::atomic<uint64_t> unmatched{};
+                Histogram match{};
+            };
+            PerThread<Counters> counters_{};
+
+        public:
+            void Record(uint64_t ns, bool matched)
+            {
+                auto& counters = counters_.Local();
+                (matched ? counters.matched : counters.unmatched).fetch_add(1U, ::std::memory_order_relaxed);
+                counters.match.Record(ns);
+            }
+            void AddTo(MetricsSnapshot::Signature& signature) const
+            {
+                counters_.ForEach(
+                    [&signature](const Counters& counters)
+                    {
+                        signature.matched += counters.matched.load(::std::memory_order_relaxed);
+                        signature.unmatched += counters.unmatched.load(::std::memory_order_relaxed);
+                        counters.match.AddTo(signature.match.counts);
+                    });
+                signature.publishes = signature.matched + signature.unmatched;
             }
         };
 
-        class Anchor
+        using Counter = ::std::conditional_t<helpers::metrics, CounterMetric, NoMetric>;
+        using Stopwatch = ::std::conditional_t<helpers::metrics, StopwatchMetric, NoMetric>;
+        using GroupMetrics = ::std::conditional_t<helpers::metrics, GroupMetric, NoMetric>;
+        using PrototypeMetrics = ::std::conditional_t<helpers::metrics, PrototypeMetric, NoMetric>;
+
+        /** @brief The memory resource from which subscriptions are allocated
+         *
+         * Unless one is given to the PubSub constructor, this is a pool of its own,
+         * which keeps freed blocks in size classes for the next subscription.  Every
+         * linker shares ownership, since an anchor may outlive its PubSub.
+         */
+        class Memory
         {
-            ::std::shared_ptr<Linker> linker_{};
+            ::std::optional<::std::pmr::synchronized_pool_resource> pool_{};
+            ::std::pmr::memory_resource* resource_{};
 
         public:
-            Anchor() = default;
-            explicit Anchor(::std::shared_ptr<Linker> linker) : linker_{ ::std::move(linker) } {}
-            virtual ~Anchor()
+            Memory() : resource_{ &pool_.emplace() } {}
+            explicit Memory(::std::pmr::memory_resource& resource) : resource_{ &resource } {}
+            Memory(Memory&&) = delete;
+            ::std::pmr::memory_resource& Resource() const { return *resource_; }
+        };
+
+        /** @brief Allocates from a Memory which it keeps alive, as needed for shared_ptr control blocks */
+        template<typename Type>
+        class MemoryAllocator
+        {
+            template<typename Other>
+            friend class MemoryAllocator;
+
+            ::std::shared_ptr<Memory> memory_{};
+
+        public:
+            using value_type = Type;
+
+            explicit MemoryAllocator(::std::shared_ptr<Memory> memory) : memory_{ ::std::move(memory) } {}
+            template<typename Other>
+            MemoryAllocator(const MemoryAllocator<Other>& other) : memory_{ other.memory_ }
             {
-                if (auto linker = ::std::move(linker_))
-                {
-                    linker->Destroy();
-                }
             }
-            Anchor& operator=(::std::nullptr_t)
+            Type* allocate(size_t count)
             {
-                auto tmp = ::std::move(*this);
-                return *this;
+                return static_cast<Type*>(memory_->Resource().allocate(count * sizeof(Type), alignof(Type)));
             }
-            Anchor(Anchor&&) = default;
-            Anchor& operator=(Anchor&&) = default;
-            Anchor(const Anchor&) = delete;
-            Anchor& operator=(const Anchor&) = delete;
-            explicit operator bool() const { return linker_ && *linker_; }
-            size_t size() const { return linker_ ? linker_->size() : 0UL; }
-            Term GetTerminator() const { return Term{ linker_ }; }
+            void deallocate(Type* p, size_t count) { memory_->Resource().deallocate(p, count * sizeof(Type), alignof(Type)); }
+            template<typename Other>
+            friend bool operator==(const MemoryAllocator& lhs, const MemoryAllocator<Other>& rhs)
+            {
+                return lhs.memory_ == rhs.memory_;
+            }
+        };
 
-            template<typename Func, typename... Args>
-            [[nodiscard]] Anchor Subscribe(Func func, Args&&... args)
+        class ElementBase
+        {
+            Linker* linker_{};
+            ElementBase* next_{}; ///< circular list of the elements sharing a linker
+            Runs* runs_{};
+            unsigned int generation_{};
+            ::std::atomic<bool> removed_{}; ///< set once unsubscribed, after which the linker may be freed
+
+            friend class Linker;
+            friend class Data;
+
+            /// @brief Placed before each element, to say where it goes when it's deleted
+            struct alignas(::std::max_align_t) Header
             {
-                Add(::std::move(func), ::std::forward<Args>(args)...);
-                return Anchor{ ::std::move(linker_) };
+                ::std::pmr::memory_resource* resource{};
+                size_t size{};
+            };
+
+            static Header& HeaderOf(void* p) { return *(static_cast<Header*>(p) - 1); }
+
+        public:
+            /** @brief Elements can only be made in a memory resource, which they return to when deleted */
+            static void* operator new(size_t size, ::std::pmr::memory_resource& resource)
+            {
+                size += sizeof(Header);
+                auto header = new (resource.allocate(size, alignof(Header))) Header{ &resource, size };
+                return header + 1;
+            }
+            static void operator delete(void* p)
+            {
+                auto [resource, size] = HeaderOf(p);
+                resource->deallocate(&HeaderOf(p), size, alignof(Header));
             }
+            /// @brief Only used if a constructor throws
+            static void operator delete(void* p, ::std::pmr::memory_resource&) { operator delete(p); }
+            /// @brief The resource an element was allocated from
+            static ::std::pmr::memory_resource& ResourceOf(ElementBase& element) { return *HeaderOf(&element).resource; }
 
-            template<typename Func, typename... Args>
-            Anchor& Add(Func func, Args&&... args)
+            /** @brief Destroys the callback of a removed element, which its runs may keep for a while */
+            struct Discard
             {
-                if (!linker_)
-                {
-                    throw ::std::runtime_error{ "Invalid anchor" };
-                }
+                void operator()(ElementBase* element) const { element->DiscardFunc(); }
+            };
+            using Discarded = ::std::unique_ptr<ElementBase, Discard>;
 
-                if (auto data = linker_->GetData().lock())
-                {
-                    auto sel = ::std::make_unique<Select<Func, helpers::SelType<Func, Args...>>>(
-                        ::std::move(func), ::std::forward<Args>(args)...);
+            Linker* GetLinker() const { return linker_; }
+            Runs* GetRuns() const { return runs_; }
+            /// @brief A removed element must not be called, nor its linker touched
+            bool Removed() const { return removed_.load(::std::memory_order_seq_cst); }
+            virtual ~ElementBase(){};
+            virtual void* GetFunc() = 0;
+            virtual void Execute(const void* args) = 0;
+            virtual void DiscardFunc() = 0;
+            virtual ::std::unique_ptr<GroupBase> MakeGroup() const = 0;
+            /// @brief Test the conditions one at a time, for runs too small to be worth indexing
+            virtual bool Matches(const void* argTuple) const = 0;
 
-                    data->AddElement(linker_, ::std::move(sel));
-                }
+            // virtual std::type_index ReturnType() const = 0;
+            virtual ::std::type_index ArgumentType() const = 0;
+            virtual ::std::type_index SelectArgs() const = 0;
+            /// @brief Identifies the group within the prototype, which several SelectTypes may share
+            virtual ::std::type_index GroupKey() const = 0;
+            virtual size_t SignatureId() const = 0;
 
-                return *this;
-            }
         };
 
-        template<typename Func, typename SelectType>
-        class Select : public ElementBase
+        class Linker
         {
-            using TupleType = helpers::GetTuple_t<Func>;
-            static inline constexpr ::std::size_t CallArgCount = ::std::tuple_size<TupleType>();
+        public:
+            class Guard;
 
-            SelectType sel_; // the select type is a common size, the func is not.
-            Func func_;
+        private:
+            ::std::atomic<size_t> size_{};
+            ::std::atomic<int> inFlight_{};         ///< callbacks in progress, counted once per thread
+            ::std::atomic<unsigned int> generation_{}; ///< advanced by Destroy(), retiring current elements
+            ::std::weak_ptr<Data> data_{};
+            ::std::shared_ptr<Memory> memory_{}; ///< where this linker was allocated
+            ::std::atomic<ElementBase*> mostRecent_{};
+
+            /// @brief Innermost callback in progress on this thread, across all linkers
+            static inline thread_local Guard* activeGuards_{};
+
+            void Leave()
+            {
+                if (inFlight_.fetch_sub(1, ::std::memory_order_seq_cst) == 1)
+                {
+                    inFlight_.notify_all();
+                }
+            }
 
         public:
-            ::std::weak_ordering Compare(const void* candidate) const override
+            Linker(::std::weak_ptr<Data> data, ::std::shared_ptr<Memory> memory) :
+                data_{ ::std::move(data) }, memory_{ ::std::move(memory) }
+            {
+            }
+            ~Linker() { Destroy(); }
+            Linker(Linker&&) = delete;
+
+            /** @brief Destroys a linker and returns it to the memory it was allocated from */
+            struct Free
+            {
+                void operator()(Linker* linker) const
+                {
+                    auto memory = ::std::move(linker->memory_);
+                    linker->~Linker();
+                    memory->Resource().deallocate(linker, sizeof(Linker), alignof(Linker));
+                }
+            };
+            using Owned = ::std::unique_ptr<Linker, Free>;
+
+            /** @brief Make a linker whose memory outlives any publisher which may still see it
+             *
+             * Publishers refer to linkers without holding a reference, so the last owner
+             * destroys the subscriptions immediately, but hands the memory to the
+             * reclaimer rather than deleting it.  The linker and its control block both
+             * come from the given memory.
+             */
+            static ::std::shared_ptr<Linker> Make(::std::weak_ptr<Data> data, ::std::shared_ptr<Memory> memory)
             {
-                auto rhs = static_cast<const TupleType*>(candidate);
-                return sel_ <=> *rhs;
+                auto storage = memory->Resource().allocate(sizeof(Linker), alignof(Linker));
+                auto linker = new (storage) Linker{ ::std::move(data), memory };
+                return ::std::shared_ptr<Linker>{ linker, &Linker::Release, MemoryAllocator<Linker>{ ::std::move(memory) } };
             }
-            ::std::weak_ordering Compare(const ElementBase* candidate) const override
+            static void Release(Linker* linker)
             {
-                auto rhs = static_cast<const Select*>(candidate);
-                return sel_ <=> rhs->sel_;
+                linker->Destroy();
+                if (auto data = linker->data_.lock())
+                {
+                    data->Retire(Owned{ linker });
+                }
+                else
+                {
+                    Free{}(linker);
+                }
             }
-            void* GetFunc() override { return static_cast<void*>(&func_); }
 
-            void Execute(const void* args) override
+            /// @return true for the first of the linker's elements
+            static bool Remember(::std::shared_ptr<Linker> self, Runs& runs, ElementBase& element)
             {
-                auto& params = *static_cast<const TupleType*>(args);
-                ::std::apply(func_, params);
+                auto previous = self->mostRecent_.exchange(&element);
+                element.next_ = previous ? ::std::exchange(previous->next_, &element) : &element;
+                element.linker_ = self.get();
+                element.runs_ = &runs;
+
+                element.generation_ = self->generation_.load();
+                ++self->size_;
+                return !previous;
             }
-            ::std::unique_ptr<ElementBase> MakeUnique() override
+            explicit operator bool() const { return mostRecent_.load(); }
+            size_t size() const { return size_.load(); }
+            ::std::weak_ptr<Data> GetData() { return data_; }
+
+            /** @brief Stop calling the elements, which publishers may still see until they're removed
+             *
+             * @return the most recent element, or nullptr if they were already stopped
+             */
+            ElementBase* Stop()
             {
-                auto result = ::std::make_unique<Select>(::std::move(*this));
-                return result;
+                auto last = mostRecent_.exchange(nullptr);
+                if (last)
+                {
+                    generation_.fetch_add(1, ::std::memory_order_seq_cst);
+                    size_ = 0;
+                }
+                return last;
             }
-            // std::type_index ReturnType() const override { return std::type_index{typeid(GetRet<Func>)}; }
-            ::std::type_index ArgumentType() const override { return ::std::type_index{ typeid(TupleType) }; }
-            ::std::type_index SelectArgs() const override { return ::std::type_index{ typeid(SelectType) }; }
 
-            template<typename Lambda, typename... Args>
-            explicit Select(Lambda&& func, Args&&... args) :
-                sel_{ helpers::ExtendTuple<helpers::SelType<Lambda, Args...>>(::std::forward<Args>(args)...) },
-                func_{ ::std::move(func) }
+            /// @brief Wait for the callbacks in progress, then remove the stopped elements
+            void Remove(ElementBase& last)
             {
+                auto waited = false;
+                for (auto count = inFlight_.load(); count != 0; count = inFlight_.load())
+                {
+                    waited = true;
+                    inFlight_.wait(count);
+                }
+                if (auto data = data_.lock())
+                {
+                    data->ReleaseNodes(last, waited);
+                }
             }
-        };
 
-        template<typename Lambda, typename... Args>
-        Select(Lambda f, Args&&... a) -> Select<Lambda, helpers::SelType<Lambda, Args...>>;
+            void Destroy()
+            {
+                auto last = Stop();
+                if (!last)
+                {
+                    return;
+                }
 
-        static inline std::string ShowTupleArgs(std::type_index id)
-        {
-            std::string tup = Demangle(id).ToString();
-            return tup.substr(11, tup.size() - 12);
-        }
+                // A callback of ours on this thread would otherwise wait for itself
+                for (auto guard = activeGuards_; guard; guard = guard->outer_)
+                {
+                    if (&guard->linker_ == this && ::std::exchange(guard->claimed_, false))
+                    {
+                        Leave();
+                    }
+                }
+                Remove(*last);
+            }
 
+            /** @brief Stop the elements at once, and leave their removal to a background thread
+             *
+             * The linker is kept until its elements have been removed, after which onDone,
+             * if given, is called on that thread.
+             */
+            static void DetachAsync(::std::shared_ptr<Linker> self, ::std::function<void()> onDone)
+            {
+                auto last = self->Stop();
+                auto data = self->data_.lock();
+                if (last && data)
+                {
+                    data->Reap(::std::move(self), *last, ::std::move(onDone));
+                }
+                else if (onDone)
+                {
+                    onDone();
+                }
+            }
 
-        /// @brief Each prototype checks all GroupSelectors, but we need to index them to insert quickly
+            /** @brief Tracks a callback in progress, so that Destroy() can wait for it
+             *
+             * The count is only claimed by the outermost guard for a linker on each
+             * thread, so recursive publishing does not count twice.  A guard is false
+             * when its element has been retired by Destroy(), so it must not be called.
+             */
+            class Guard
+            {
+                friend class Linker;
 
-        /** Tag for PubSub constructor to force it to remove empty elements from
-         * the subscription database
-         * 
-         * This is generally not recommended, because the number of empty
-         * elements is set at compile time and is unlikely to be significant.
-         */
-        struct RemoveEmptySets{};
+                Linker& linker_;
+                Guard* outer_{ activeGuards_ };
+                bool claimed_{};
+                bool live_{};
 
-        class Data
+            public:
+                Guard(Linker& linker, const ElementBase& element) : linker_{ linker }
+                {
+                    auto nested = false;
+                    for (auto guard = outer_; guard; guard = guard->outer_)
+                    {
+                        nested = nested || (&guard->linker_ == &linker && guard->claimed_);
+                    }
+                    if (!nested)
+                    {
+                        linker.inFlight_.fetch_add(1, ::std::memory_order_seq_cst);
+                        claimed_ = true;
+                    }
+                    live_ = linker.generation_.load(::std::memory_order_seq_cst) == element.generation_;
+                    activeGuards_ = this;
+                }
+                ~Guard()
+                {
+                    activeGuards_ = outer_;
+                    if (claimed_)
+                    {
+                        linker_.Leave();
+                    }
+                }
+                Guard(Guard&&) = delete;
+                explicit operator bool() const { return live_; }
+            };
+        };
+
+        /** @brief The matches found for one event
+         *
+         * One match is kept inline, and more spill into a vector.  The vector may be
+         * borrowed from the caller, which keeps its capacity from one event to the next.
+         */
+        template <class Type>
+        class MatchResults
         {
-            Database_t database_{};
-            mutable ::std::shared_mutex lock_{};
-            ::std::ostream* debugStream_{};
-            bool removeEmptySets_{false};
+            size_t size_{};
+            union
+            {
+                Type short_[1];
+            };
+            ::std::vector<Type> own_{};
+            ::std::vector<Type>* long_{ &own_ };
+
+            constexpr inline static size_t maxShort = sizeof(short_) / sizeof(short_[0]);
+            constexpr inline static size_t firstSpill = 8;
+
+        public:
+            MatchResults() {}
+            /// @brief Spill into the caller's buffer, which must outlive the results
+            explicit MatchResults(::std::vector<Type>& buffer) : long_{ &buffer } { buffer.clear(); }
+            MatchResults(MatchResults&& donor) noexcept :
+                size_{ ::std::exchange(donor.size_, 0U) },
+                own_{ ::std::move(donor.own_) },
+                long_{ donor.long_ == &donor.own_ ? &own_ : donor.long_ }
+            {
+                if (size_ <= maxShort)
+                {
+                    for (size_t i = 0 ; i < size_ ; ++i)
+                    {
+                        new (&short_[i]) Type {::std::move(donor.short_[i])};
+                        donor.short_[i].~Type();
+                    }
+                }
+            }
+            ~MatchResults()
+            {
+                if (size_ <= maxShort)
+                {
+                    for (size_t i = 0 ; i < size_; ++i)
+                    {
+                        short_[i].~Type();
+                    }
+                }
+            }
+            void push_back(Type t)
+            {
+                if (size_ < maxShort)
+                {
+                    new (&short_[size_++]) Type{ ::std::move(t) };
+                }
+                else if (size_ == maxShort)
+                {
+                    ++size_;
+                    long_->reserve(firstSpill);
+                    for (auto& x : short_)
+                    {
+                        long_->push_back(::std::move(x));
+                        x.~Type();
+                    }
+                    long_->push_back(::std::move(t));
+                }
+                else {
+                    ++size_;
+                    long_->push_back(::std::move(t));
+                }
+            }
+            using const_iterator = const Type*;
+            const_iterator begin() const { return size_ <= maxShort ? ::std::begin(short_) : long_->data(); }
+            const_iterator end() const { return begin() + size_; }
+        };
+
+        /** @brief One run of the subscriptions of a prototype which share a SelectType
+         *
+         * A group is built by inserting the elements of its run, and never changes once
+         * publishers can see it, so matching needs no lock.  It refers to its elements
+         * without owning them.  Each SelectType picks the kind of group which can index
+         * its conditions best, and the group never needs to call a virtual function to
+         * compare them.
+         */
+        class GroupBase
+        {
+        public:
+            virtual ~GroupBase() = default;
+            virtual void Insert(ElementBase& element) = 0;
+            /// @brief append every element matching the argument tuple
+            virtual void Match(const void* argTuple, MatchResults<ElementBase*>& winners) const = 0;
+        };
+
+        /** @brief Group for a run of no more than Runs::levelRatio elements, which tests each in turn
+         *
+         * Small runs are rebuilt on almost every subscribe, so a plain list, whatever
+         * the SelectType, is cheaper than an index which would hardly be used.
+         */
+        class ScanGroup : public GroupBase
+        {
+            ::std::vector<ElementBase*> elements_{};
+
+        public:
+            void Insert(ElementBase& element) override { elements_.push_back(&element); }
+            void Match(const void* argTuple, MatchResults<ElementBase*>& winners) const override
+            {
+                for (auto element : elements_)
+                {
+                    if (element->Matches(argTuple))
+                    {
+                        winners.push_back(element);
+                    }
+                }
+            }
+        };
+
+        /** @brief General purpose group, ordered so that modifiers such as GE<> can find ranges
+         *
+         * The conditions are kept in sorted blocks of flat entries, beside their
+         * element, with a flat index of the last entry of each block; it's a B+-tree
+         * of height two.  A lookup is then a binary search of the index and of one
+         * block, neither of which leaves the keys.  Conditions which can't be copied
+         * trivially stay in the element, and the entries point at them instead, so
+         * subscribing never copies them.  Entries with equal conditions are kept in
+         * the order they were inserted.
+         */
+        template<typename TupleType, typename SelectType>
+        class OrderedGroup : public GroupBase
+        {
+            using Element = Selection<TupleType, SelectType>;
+            static constexpr bool inlineKeys = ::std::is_trivially_copyable_v<helpers::MutableTuple<SelectType>>;
+            using Key = ::std::conditional_t<inlineKeys, helpers::MutableTuple<SelectType>, const SelectType*>;
+            static constexpr size_t maxBlock = 1'024U;
+
+            struct Entry
+            {
+                Key key;
+                Element* element;
+
+                explicit Entry(Element& e) : key{ MakeKey(e) }, element{ &e } {}
+
+                static Key MakeKey(const Element& e)
+                {
+                    if constexpr (inlineKeys)
+                    {
+                        return Key{ e.GetSelect() };
+                    }
+                    else
+                    {
+                        return &e.GetSelect();
+                    }
+                }
+                const auto& GetKey() const
+                {
+                    if constexpr (inlineKeys)
+                    {
+                        return key;
+                    }
+                    else
+                    {
+                        return *key;
+                    }
+                }
+            };
+
+            struct Compare
+            {
+                bool operator()(const Entry& lhs, const Entry& rhs) const { return (lhs.GetKey() <=> rhs.GetKey()) < 0; }
+                bool operator()(const Entry& lhs, const TupleType& rhs) const { return (lhs.GetKey() <=> rhs) < 0; }
+                bool operator()(const TupleType& lhs, const Entry& rhs) const { return (rhs.GetKey() <=> lhs) > 0; }
+            };
+            using Block = ::std::vector<Entry>;
+
+            ::std::vector<Entry> lasts_{}; ///< the last entry of each block
+            ::std::vector<Block> blocks_{};
+
+            /// @brief The first block which might hold the value, by the index alone
+            template<typename Value>
+            size_t FirstBlock(const Value& value) const
+            {
+                return static_cast<size_t>(
+                    ::std::lower_bound(lasts_.begin(), lasts_.end(), value, Compare{}) - lasts_.begin());
+            }
+
+        public:
+            OrderedGroup() = default;
+            OrderedGroup(OrderedGroup&&) = delete;
+            void Insert(ElementBase& base) override
+            {
+                Entry entry{ static_cast<Element&>(base) };
+                if (blocks_.empty())
+                {
+                    blocks_.emplace_back();
+                    lasts_.push_back(entry);
+                }
+                auto b = static_cast<size_t>(
+                    ::std::upper_bound(lasts_.begin(), lasts_.end(), entry, Compare{}) - lasts_.begin());
+                b = ::std::min(b, blocks_.size() - 1U);
+                auto& block = blocks_[b];
+                block.insert(::std::upper_bound(block.begin(), block.end(), entry, Compare{}), entry);
+                lasts_[b] = block.back();
+                if (block.size() > maxBlock)
+                {
+                    Block upper(block.begin() + maxBlock / 2U, block.end());
+                    block.erase(block.begin() + maxBlock / 2U, block.end());
+                    lasts_[b] = block.back();
+                    lasts_.insert(lasts_.begin() + static_cast<::std::ptrdiff_t>(b) + 1, upper.back());
+                    blocks_.insert(blocks_.begin() + static_cast<::std::ptrdiff_t>(b) + 1, ::std::move(upper));
+                }
+            }
+            void Match(const void* argTuple, MatchResults<ElementBase*>& winners) const override
+            {
+                const auto& args = *static_cast<const TupleType*>(argTuple);
+                for (auto b = FirstBlock(args); b < blocks_.size(); ++b)
+                {
+                    const auto& block = blocks_[b];
+                    auto [first, last] = ::std::equal_range(block.begin(), block.end(), args, Compare{});
+                    for (auto it = first; it != last; ++it)
+                    {
+                        winners.push_back(it->element);
+                    }
+                    if (last != block.end())
+                    {
+                        break;
+                    }
+                }
+            }
+        };
+
+        /** @brief Group for selectors with BitSelect<> among exact conditions or tbd::any, found with one hash probe
+         *
+         * Elements with equal conditions share a bucket, in which they are kept in the
+         * order they were added.  Since the mask of a BitSelect<> is part of its type, each
+         * distinct mask has a group of its own, and one probe finds every matching bit
+         * pattern under it.
+         */
+        template<typename TupleType, typename SelectType>
+        class HashedGroup : public GroupBase
+        {
+            using Element = Selection<TupleType, SelectType>;
+            using Key = helpers::SelectKey<SelectType>;
+
+            using Bucket = ::std::vector<Element*>;
+            using Buckets = ::std::unordered_map<Key, Bucket, helpers::SelectHash<SelectType>, helpers::TupleEqual>;
+
+            Buckets buckets_{};
+
+        public:
+            HashedGroup() = default;
+            HashedGroup(HashedGroup&&) = delete;
+            void Insert(ElementBase& base) override
+            {
+                auto& element = static_cast<Element&>(base);
+                buckets_.try_emplace(helpers::MakeSelectKey(element.GetSelect())).first->second.push_back(&element);
+            }
+            void Match(const void* argTuple, MatchResults<ElementBase*>& winners) const override
+            {
+                if (auto it = buckets_.find(*static_cast<const TupleType*>(argTuple)); it != buckets_.end())
+                {
+                    for (auto element : it->second)
+                    {
+                        winners.push_back(element);
+                    }
+                }
+            }
+        };
+
+        /** @brief Group for selectors with one GE, GT, LE or LT condition, found in O(log n + matches)
+         *
+         * The remaining conditions are hashed as for HashedGroup, and each bucket keeps
+         * the bounds of its range condition in order.  A published value is below or above
+         * all of the bounds which it satisfies, so they form a prefix or a suffix.
+         */
+        template<typename TupleType, typename SelectType>
+        class IntervalGroup : public GroupBase
+        {
+            using Element = Selection<TupleType, SelectType>;
+            using Key = helpers::SelectKey<SelectType>;
+            static constexpr size_t rangeSlot = helpers::RangeSlot<SelectType>;
+            using Range = helpers::RangeCondition<::std::remove_cvref_t<::std::tuple_element_t<rangeSlot, SelectType>>>;
+            using Bounds = ::std::multimap<typename Range::Value, Element*>;
+            using Buckets = ::std::unordered_map<Key, Bounds, helpers::SelectHash<SelectType>, helpers::TupleEqual>;
+
+            Buckets buckets_{};
+
+        public:
+            IntervalGroup() = default;
+            IntervalGroup(IntervalGroup&&) = delete;
+            void Insert(ElementBase& base) override
+            {
+                auto& element = static_cast<Element&>(base);
+                auto& bounds = buckets_.try_emplace(helpers::MakeSelectKey(element.GetSelect())).first->second;
+                bounds.emplace(::std::get<rangeSlot>(element.GetSelect()).Value(), &element);
+            }
+            void Match(const void* argTuple, MatchResults<ElementBase*>& winners) const override
+            {
+                const auto& args = *static_cast<const TupleType*>(argTuple);
+                if (auto it = buckets_.find(args); it != buckets_.end())
+                {
+                    const auto& bounds = it->second;
+                    const auto& value = ::std::get<rangeSlot>(args);
+                    auto first = bounds.begin();
+                    auto last = bounds.end();
+                    if constexpr (Range::lower)
+                    {
+                        last = Range::inclusive ? bounds.upper_bound(value) : bounds.lower_bound(value);
+                    }
+                    else
+                    {
+                        first = Range::inclusive ? bounds.lower_bound(value) : bounds.upper_bound(value);
+                    }
+                    for (; first != last; ++first)
+                    {
+                        winners.push_back(first->second);
+                    }
+                }
+            }
+        };
+
+        /** @brief An element of a ColumnarGroup, whose conditions are all ScalarBounds */
+        template<typename TupleType>
+        class ColumnarElement : public ElementBase
+        {
+        public:
+            using Row = ::std::array<helpers::ScalarBound<helpers::ScalarWord<TupleType>>, ::std::tuple_size_v<TupleType>>;
+            virtual Row GetRow() const = 0;
+        };
+
+        /** @brief Group for scalar conditions which can't be hashed, such as several ranges
+         *
+         * Every such selector of a prototype shares the one group, whatever its SelectType,
+         * since each condition is reduced to a ScalarBound.  The bounds are stored by
+         * column, and matching scans several rows at a time with vector instructions where
+         * the compiler supports them.
+         */
+        template<typename TupleType>
+        class ColumnarGroup : public GroupBase
+        {
+            static constexpr size_t slots = ::std::tuple_size_v<TupleType>;
+            using Element = ColumnarElement<TupleType>;
+            using Word = helpers::ScalarWord<TupleType>;
+            using SignedWord = ::std::make_signed_t<Word>;
+            using Column = ::std::vector<Word>;
+            using Values = ::std::array<Word, slots>;
+            /// @brief Spans are stored biased, to be compared as signed values
+            static constexpr Word bias = Word{ 1U } << (sizeof(Word) * 8U - 1U);
+
+            ::std::array<Column, slots> low_{};
+            ::std::array<Column, slots> span_{};
+            ::std::array<Column, slots> mask_{};
+            ::std::vector<Element*> rows_{};
+
+            template<size_t... I>
+            static Values Encode(const TupleType& args, ::std::index_sequence<I...>)
+            {
+                return { helpers::OrderedBits<Word>(::std::get<I>(args))... };
+            }
+
+            bool Matches(size_t row, const Values& values) const
+            {
+                for (size_t slot{}; slot < slots; ++slot)
+                {
+                    auto bits = static_cast<Word>(((values[slot] & mask_[slot][row]) - low_[slot][row]) ^ bias);
+                    if (static_cast<SignedWord>(bits) > static_cast<SignedWord>(span_[slot][row]))
+                    {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            /// @brief Matches whole vectors of rows, returning the first row it didn't reach
+            size_t MatchLanes(const Values& values, MatchResults<ElementBase*>& winners) const
+            {
+                size_t row{};
+#if defined(__GNUC__) && (defined(__SSE2__) || defined(__ARM_NEON))
+                if constexpr (sizeof(Word) == sizeof(uint32_t) || helpers::wideVectorCompare)
+                {
+                    // there's no unsigned vector comparison, so compare biased signed values
+#if defined(__AVX2__)
+                    using Lanes [[gnu::vector_size(32)]] = Word;
+                    using Signed [[gnu::vector_size(32)]] = SignedWord;
+#else
+                    using Lanes [[gnu::vector_size(16)]] = Word;
+                    using Signed [[gnu::vector_size(16)]] = SignedWord;
+#endif
+                    constexpr size_t width = sizeof(Lanes) / sizeof(Word);
+                    auto load = [](const Column& column, size_t at)
+                    {
+                        Lanes lanes;
+                        ::std::memcpy(&lanes, column.data() + at, sizeof(lanes));
+                        return lanes;
+                    };
+                    for (; row + width <= rows_.size(); row += width)
+                    {
+                        Signed hits = ~Signed{};
+                        for (size_t slot{}; slot < slots; ++slot)
+                        {
+                            auto bits = ((values[slot] & load(mask_[slot], row)) - load(low_[slot], row)) ^ bias;
+                            hits &= reinterpret_cast<Signed>(bits) <= reinterpret_cast<Signed>(load(span_[slot], row));
+                        }
+                        for (size_t lane{}; lane < width; ++lane)
+                        {
+                            if (hits[lane])
+                            {
+                                winners.push_back(rows_[row + lane]);
+                            }
+                        }
+                    }
+                }
+#endif
+                return row;
+            }
+
+        public:
+            ColumnarGroup() = default;
+            ColumnarGroup(ColumnarGroup&&) = delete;
+            void Insert(ElementBase& base) override
+            {
+                auto& element = static_cast<Element&>(base);
+                auto row = element.GetRow();
+                for (size_t slot{}; slot < slots; ++slot)
+                {
+                    low_[slot].push_back(row[slot].low);
+                    span_[slot].push_back(row[slot].span ^ bias);
+                    mask_[slot].push_back(row[slot].mask);
+                }
+                rows_.push_back(&element);
+            }
+            void Match(const void* argTuple, MatchResults<ElementBase*>& winners) const override
+            {
+                const auto values =
+                    Encode(*static_cast<const TupleType*>(argTuple), ::std::make_index_sequence<slots>{});
+                for (auto row = MatchLanes(values, winners); row < rows_.size(); ++row)
+                {
+                    if (Matches(row, values))
+                    {
+                        winners.push_back(rows_[row]);
+                    }
+                }
+            }
+        };
+
+        /** @brief An element of a DiscriminationGroup, which gives the keys of its conditions */
+        template<typename TupleType>
+        class DiscriminationElement : public ElementBase
+        {
+        public:
+            using Keys = ::std::array<size_t, ::std::tuple_size_v<TupleType>>;
+            using Wild = ::std::bitset<::std::tuple_size_v<TupleType>>;
+
+            virtual Keys GetKeys(Wild& wild) const = 0;
+            /// @brief Confirms a match, where equal keys don't imply equal values
+            virtual bool Accepts(const TupleType& args) const = 0;
+        };
+
+        template<typename TupleType>
+        struct DiscriminationNode
+        {
+            using Element = DiscriminationElement<TupleType>;
+            static constexpr size_t slots = ::std::tuple_size_v<TupleType>;
+
+            /// @brief An element listed at a node, with the keys it's branched on
+            struct Entry
+            {
+                typename Element::Keys keys{};
+                typename Element::Wild wild{}; ///< the slots whose condition is tbd::any
+                Element* element{};
+            };
+
+            typename Element::Wild decided{}; ///< the slots branched on by this node and its parents
+            size_t slot{ slots }; ///< the slot this node branches on, or slots for a leaf
+            ::std::unordered_map<size_t, ::std::unique_ptr<DiscriminationNode>> children{};
+            ::std::unique_ptr<DiscriminationNode> wildcard{};
+            ::std::vector<Entry> entries{};
+            size_t splitAt{};
+        };
+
+        /** @brief Group for selectors of exact conditions and tbd::any, as a discrimination network
+         *
+         * Every such selector of a prototype shares the one tree.  Each leaf lists a few
+         * elements; when a leaf fills up it branches on whichever undecided slot has the
+         * most distinct conditions, with one child per condition, and a wildcard child which
+         * is shared by every element with tbd::any in that slot.  Matching follows the child
+         * for the published value and the wildcard child at each branch, so it visits only
+         * the nodes consistent with the event, however many SelectTypes there are.
+         */
+        template<typename TupleType>
+        class DiscriminationGroup : public GroupBase
+        {
+            static constexpr size_t slots = ::std::tuple_size_v<TupleType>;
+            static constexpr size_t leafSize = 8;
+            static constexpr bool exact = []<size_t... I>(::std::index_sequence<I...>)
+            {
+                return (helpers::exactDiscriminationKey<::std::remove_cvref_t<::std::tuple_element_t<I, TupleType>>> && ...);
+            }(::std::make_index_sequence<slots>{});
+            using Element = DiscriminationElement<TupleType>;
+            using Node = DiscriminationNode<TupleType>;
+            using Entry = typename Node::Entry;
+            using Keys = typename Element::Keys;
+
+            Node root_{ .splitAt = leafSize };
+
+            template<size_t... I>
+            static Keys MakeKeys(const TupleType& args, ::std::index_sequence<I...>)
+            {
+                return { helpers::DiscriminationKey(::std::get<I>(args))... };
+            }
+
+            static Node& Child(Node& node, const Entry& entry)
+            {
+                auto make = [&node]
+                {
+                    auto child = ::std::make_unique<Node>();
+                    child->decided = node.decided;
+                    child->decided.set(node.slot);
+                    child->splitAt = leafSize;
+                    return child;
+                };
+                if (entry.wild.test(node.slot))
+                {
+                    if (!node.wildcard)
+                    {
+                        node.wildcard = make();
+                    }
+                    return *node.wildcard;
+                }
+                auto& child = node.children[entry.keys[node.slot]];
+                if (!child)
+                {
+                    child = make();
+                }
+                return *child;
+            }
+
+            /// @brief Branch a full leaf on its most selective slot, if any slot tells its elements apart
+            static void Split(Node& node)
+            {
+                size_t best{ slots };
+                size_t bestDistinct{ 1U };
+                for (size_t slot{}; slot < slots; ++slot)
+                {
+                    if (node.decided.test(slot))
+                    {
+                        continue;
+                    }
+                    ::std::unordered_set<size_t> distinct{};
+                    for (const auto& entry : node.entries)
+                    {
+                        if (!entry.wild.test(slot))
+                        {
+                            distinct.insert(entry.keys[slot]);
+                        }
+                    }
+                    if (distinct.size() > bestDistinct)
+                    {
+                        best = slot;
+                        bestDistinct = distinct.size();
+                    }
+                }
+                if (best == slots)
+                {
+                    node.splitAt = node.entries.size() * 2U;
+                    return;
+                }
+                node.slot = best;
+                for (auto& entry : ::std::exchange(node.entries, {}))
+                {
+                    Child(node, entry).entries.push_back(entry);
+                }
+                auto splitChild = [](Node& child)
+                {
+                    if (child.entries.size() >= child.splitAt)
+                    {
+                        Split(child);
+                    }
+                };
+                for (auto& [key, child] : node.children)
+                {
+                    splitChild(*child);
+                }
+                if (node.wildcard)
+                {
+                    splitChild(*node.wildcard);
+                }
+            }
+
+            void Collect(const Node& node, const Keys& keys, const TupleType& args, MatchResults<ElementBase*>& winners) const
+            {
+                for (const auto& entry : node.entries)
+                {
+                    bool match{ true };
+                    for (size_t slot{}; slot < slots && match; ++slot)
+                    {
+                        match = entry.wild.test(slot) || entry.keys[slot] == keys[slot];
+                    }
+                    if (match && (exact || entry.element->Accepts(args)))
+                    {
+                        winners.push_back(entry.element);
+                    }
+                }
+                if (node.slot == slots)
+                {
+                    return;
+                }
+                if (auto it = node.children.find(keys[node.slot]); it != node.children.end())
+                {
+                    Collect(*it->second, keys, args, winners);
+                }
+                if (node.wildcard)
+                {
+                    Collect(*node.wildcard, keys, args, winners);
+                }
+            }
+
+        public:
+            DiscriminationGroup() = default;
+            DiscriminationGroup(DiscriminationGroup&&) = delete;
+            void Insert(ElementBase& base) override
+            {
+                Entry entry{};
+                entry.element = &static_cast<Element&>(base);
+                entry.keys = entry.element->GetKeys(entry.wild);
+                auto node = &root_;
+                while (node->slot != slots)
+                {
+                    node = &Child(*node, entry);
+                }
+                node->entries.push_back(entry);
+                if (node->entries.size() >= node->splitAt)
+                {
+                    Split(*node);
+                }
+            }
+            void Match(const void* argTuple, MatchResults<ElementBase*>& winners) const override
+            {
+                const auto& args = *static_cast<const TupleType*>(argTuple);
+                Collect(root_, MakeKeys(args, ::std::make_index_sequence<slots>{}), args, winners);
+            }
+        };
+
+        template<typename TupleType, typename SelectType>
+        using GroupFor = ::std::conditional_t<
+            helpers::HashableSelect<TupleType, SelectType>,
+            ::std::conditional_t<
+                helpers::DiscriminationSelect<TupleType, SelectType>,
+                DiscriminationGroup<TupleType>,
+                HashedGroup<TupleType, SelectType>>,
+            ::std::conditional_t<
+                helpers::IntervalSelect<TupleType, SelectType>,
+                IntervalGroup<TupleType, SelectType>,
+                ::std::conditional_t<
+                    helpers::ColumnarSelect<TupleType, SelectType>,
+                    ColumnarGroup<TupleType>,
+                    OrderedGroup<TupleType, SelectType>>>>;
+
+        /** @brief Makes a Selection a row of a ColumnarGroup, encoding its conditions on demand */
+        template<typename TupleType, typename SelectType>
+        class ColumnarRow : public ColumnarElement<TupleType>
+        {
+            template<size_t... I>
+            static auto MakeRow(const SelectType& sel, ::std::index_sequence<I...>)
+            {
+                return typename ColumnarElement<TupleType>::Row{
+                    helpers::MakeScalarBound<helpers::ScalarWord<TupleType>,
+                                             ::std::remove_cvref_t<::std::tuple_element_t<I, TupleType>>,
+                                             ::std::remove_cvref_t<::std::tuple_element_t<I, SelectType>>>(
+                        ::std::get<I>(sel))...
+                };
+            }
+
+        public:
+            typename ColumnarElement<TupleType>::Row GetRow() const override
+            {
+                return MakeRow(
+                    static_cast<const Selection<TupleType, SelectType>&>(*this).GetSelect(),
+                    ::std::make_index_sequence<::std::tuple_size_v<TupleType>>{});
+            }
+        };
+
+        /** @brief Makes a Selection an element of a DiscriminationGroup */
+        template<typename TupleType, typename SelectType>
+        class DiscriminationRow : public DiscriminationElement<TupleType>
+        {
+            using Base = DiscriminationElement<TupleType>;
+
+            const SelectType& GetSelect() const
+            {
+                return static_cast<const Selection<TupleType, SelectType>&>(*this).GetSelect();
+            }
+
+        public:
+            typename Base::Keys GetKeys(typename Base::Wild& wild) const override
+            {
+                typename Base::Keys keys{};
+                [&]<size_t... I>(::std::index_sequence<I...>)
+                {
+                    (
+                        [&](const auto& condition)
+                        {
+                            if constexpr (helpers::IsAny<decltype(condition)>)
+                            {
+                                wild.set(I);
+                            }
+                            else
+                            {
+                                keys[I] = helpers::DiscriminationKey(condition);
+                            }
+                        }(::std::get<I>(GetSelect())),
+                        ...);
+                }(::std::make_index_sequence<::std::tuple_size_v<TupleType>>{});
+                return keys;
+            }
+            bool Accepts(const TupleType& args) const override { return GetSelect() == args; }
+        };
+
+        /// @brief The element base for a SelectType, which for a shared group tells the group about its conditions
+        template<typename TupleType, typename SelectType>
+        using RowFor = ::std::conditional_t<
+            helpers::ColumnarSelect<TupleType, SelectType>,
+            ColumnarRow<TupleType, SelectType>,
+            ::std::conditional_t<
+                helpers::DiscriminationSelect<TupleType, SelectType>,
+                DiscriminationRow<TupleType, SelectType>,
+                ElementBase>>;
+
+        /** @brief The part of every element which its group needs, independent of the callback */
+        template<typename TupleType, typename SelectType>
+        class Selection : public RowFor<TupleType, SelectType>
+        {
+        public:
+            using Group = GroupFor<TupleType, SelectType>;
+
+        private:
+            SelectType sel_; // the select type is a common size, the func is not.
+
+        protected:
+            template<typename... Args>
+            explicit Selection(::std::in_place_t, Args&&... args) :
+                sel_{ helpers::ExtendTuple<SelectType>(::std::forward<Args>(args)...) }
+            {
+            }
+
+        public:
+            const SelectType& GetSelect() const { return sel_; }
+            ::std::unique_ptr<GroupBase> MakeGroup() const override { return ::std::make_unique<Group>(); }
+            bool Matches(const void* argTuple) const override
+            {
+                const auto& args = *static_cast<const TupleType*>(argTuple);
+                if constexpr (requires { sel_ <=> args; })
+                {
+                    return (sel_ <=> args) == 0;
+                }
+                else
+                {
+                    return sel_ == args;
+                }
+            }
+            size_t SignatureId() const override { return helpers::SignatureId<TupleType>(); }
+            ::std::type_index GroupKey() const override
+            {
+                if constexpr (::std::is_same_v<RowFor<TupleType, SelectType>, ElementBase>)
+                {
+                    return ::std::type_index{ typeid(SelectType) };
+                }
+                else
+                {
+                    return ::std::type_index{ typeid(Group) };
+                }
+            }
+        };
+
+        /** @brief The subscriptions of a prototype which share a group key, in runs which never change once built
+         *
+         * As in a leveled LSM tree, each level holds one run, indexed by a group of its
+         * own, and each level holds levelRatio times as many elements as the one below.
+         * A new element rebuilds the smallest run, and a run which outgrows its level is
+         * merged into the next, so each element is indexed O(log n) times, and publishers
+         * match O(log n) groups.  Removing an element only flags it, so that publishers
+         * skip it, until the flagged elements outnumber the live ones, when all the runs
+         * are merged into one without them.
+         *
+         * Only writers use the runs, under the data lock, except for the metrics.
+         */
+        class Runs
+        {
+        public:
+            static constexpr size_t levelRatio = 8U;
+
+            /// @brief What rebuilding the runs replaced, which publishers may still be using
+            struct Replaced
+            {
+                ::std::vector<::std::unique_ptr<GroupBase>> groups{};
+                ::std::vector<ElementBase*> elements{}; ///< removed elements which no run refers to any more
+            };
+
+        private:
+            struct Run
+            {
+                ::std::vector<ElementBase*> elements{}; ///< from the oldest
+                ::std::unique_ptr<GroupBase> group{};
+            };
+
+            ::std::vector<Run> levels_{};
+            ::std::atomic<size_t> live_{}; ///< written under the data lock, read without it by Statistics()
+            size_t removed_{}; ///< flagged elements which are still in a run
+
+            static size_t Capacity(size_t level)
+            {
+                auto capacity = levelRatio;
+                for (; level != 0U; --level)
+                {
+                    capacity *= levelRatio;
+                }
+                return capacity;
+            }
+
+            /// @brief Index a run again, leaving out the elements which have been removed since
+            void Build(Run& run, Replaced& replaced)
+            {
+                if (run.group)
+                {
+                    replaced.groups.push_back(::std::move(run.group));
+                }
+                ::std::erase_if(
+                    run.elements,
+                    [this, &replaced](ElementBase* element)
+                    {
+                        if (!element->Removed())
+                        {
+                            return false;
+                        }
+                        replaced.elements.push_back(element);
+                        --removed_;
+                        return true;
+                    });
+                if (run.elements.empty())
+                {
+                    return;
+                }
+                if (run.elements.size() <= levelRatio)
+                {
+                    run.group = ::std::make_unique<ScanGroup>();
+                }
+                else
+                {
+                    run.group = run.elements.front()->MakeGroup();
+                }
+                for (auto element : run.elements)
+                {
+                    run.group->Insert(*element);
+                }
+            }
+
+        public:
+            Runs() = default;
+            Runs(Runs&&) = delete;
+            ~Runs()
+            {
+                for (auto& run : levels_)
+                {
+                    for (auto element : run.elements)
+                    {
+                        delete element;
+                    }
+                }
+            }
+
+            void Add(ElementBase& element, Replaced& replaced)
+            {
+                if (levels_.empty())
+                {
+                    levels_.emplace_back();
+                }
+                levels_.front().elements.push_back(&element);
+                size_t level{};
+                for (; levels_[level].elements.size() > Capacity(level); ++level)
+                {
+                    if (level + 1U == levels_.size())
+                    {
+                        levels_.emplace_back();
+                    }
+                    auto& lower = levels_[level];
+                    auto& upper = levels_[level + 1U].elements;
+                    upper.insert(upper.end(), lower.elements.begin(), lower.elements.end());
+                    lower.elements.clear();
+                    if (lower.group)
+                    {
+                        replaced.groups.push_back(::std::move(lower.group));
+                    }
+                }
+                Build(levels_[level], replaced);
+                live_.fetch_add(1U, ::std::memory_order_relaxed);
+            }
+
+            /// @brief Count an element which has just been flagged as removed
+            void Remove(Replaced& replaced)
+            {
+                auto live = live_.fetch_sub(1U, ::std::memory_order_relaxed) - 1U;
+                ++removed_;
+                if (removed_ <= live)
+                {
+                    return;
+                }
+                Run merged{};
+                for (auto level = levels_.rbegin(); level != levels_.rend(); ++level)
+                {
+                    merged.elements.insert(merged.elements.end(), level->elements.begin(), level->elements.end());
+                    if (level->group)
+                    {
+                        replaced.groups.push_back(::std::move(level->group));
+                    }
+                }
+                levels_.clear();
+                Build(merged, replaced);
+                if (live != 0U)
+                {
+                    size_t level{};
+                    while (Capacity(level) < live)
+                    {
+                        ++level;
+                    }
+                    levels_.resize(level + 1U);
+                    levels_.back() = ::std::move(merged);
+                }
+            }
+
+            /// @brief Append the group of each run, from the oldest
+            void Collect(::std::vector<const GroupBase*>& groups) const
+            {
+                for (auto level = levels_.rbegin(); level != levels_.rend(); ++level)
+                {
+                    if (level->group)
+                    {
+                        groups.push_back(level->group.get());
+                    }
+                }
+            }
+
+            size_t size() const { return live_.load(::std::memory_order_relaxed); }
+            bool empty() const { return size() == 0U; }
+
+            [[no_unique_address]] mutable GroupMetrics metrics{};
+        };
+
+        /** @brief A value which readers load without a lock, and which writers replace rather than change
+         *
+         * The value replaced is handed back, since readers may still be using it; the
+         * caller retires it.
+         */
+        template<typename Type>
+        class Published
+        {
+            ::std::atomic<const Type*> current_{};
+
+        public:
+            Published() = default;
+            Published(Published&&) = delete;
+            ~Published() { delete current_.load(::std::memory_order_relaxed); }
+            const Type* Load() const { return current_.load(::std::memory_order_acquire); }
+            ::std::unique_ptr<const Type> Exchange(::std::unique_ptr<const Type> value)
+            {
+                return ::std::unique_ptr<const Type>{ current_.exchange(value.release(), ::std::memory_order_acq_rel) };
+            }
+        };
+
+        /// @brief What publishers match for one call signature: the group of every run
+        struct Snapshot
+        {
+            ::std::vector<const GroupBase*> groups{};
+            ::std::vector<::std::pair<::std::type_index, const Runs*>> runs{}; ///< by group key, for Statistics()
+        };
+
+        /// @brief Runs by ElementBase::GroupKey(), which is the SelectType unless the group is shared
+        using PerPrototype = ::std::unordered_map<::std::type_index, ::std::unique_ptr<Runs>>;
+
+        /** @brief All of the selectors for one call signature
+         *
+         * Only the snapshot and the metrics are for publishers; writers change the rest
+         * under the data lock, and publish a new snapshot.
+         */
+        struct Prototype
+        {
+            PerPrototype selectors{};
+            Published<Snapshot> snapshot{};
+            ::std::unordered_map<::std::type_index, size_t> selectTypes{}; ///< subscriptions by SelectType
+            size_t publishers{}; ///< Publisher handles which hold a pointer to this prototype
+            [[no_unique_address]] mutable PrototypeMetrics metrics{};
+        };
+        using Database_t = ::std::unordered_map<::std::type_index, ::std::unique_ptr<Prototype>>;
+        /// @brief What publishers look call signatures up in, which is published like a snapshot
+        using Directory = ::std::unordered_map<::std::type_index, const Prototype*>;
+
+        /** @brief Gives each thread a slot of its own, for counters which only that thread writes
+         *
+         * A thread claims the first free slot when it first asks, and frees it when it
+         * exits.  Beyond slotCount threads at once, threads share slots, so the
+         * counters in them must still be atomic.
+         */
+        class ThreadSlots
+        {
+        public:
+            static constexpr size_t slotCount = 64;
+
+        private:
+            static inline ::std::array<::std::atomic<bool>, slotCount> claimed_{};
+            static inline ::std::atomic<size_t> shared_{};
+
+            struct Claim
+            {
+                size_t slot{ slotCount };
+                bool owned{};
+                Claim()
+                {
+                    for (size_t candidate{}; candidate < slotCount && !owned; ++candidate)
+                    {
+                        owned = !claimed_[candidate].exchange(true, ::std::memory_order_acquire);
+                        slot = candidate;
+                    }
+                    if (!owned)
+                    {
+                        slot = shared_.fetch_add(1U, ::std::memory_order_relaxed) % slotCount;
+                    }
+                }
+                ~Claim()
+                {
+                    if (owned)
+                    {
+                        claimed_[slot].store(false, ::std::memory_order_release);
+                    }
+                }
+            };
+
+        public:
+            /** @brief The slot used by the calling thread */
+            static size_t Get()
+            {
+                thread_local const Claim claim{};
+                return claim.slot;
+            }
+        };
+
+        /** @brief The writers' mutex, which counts how often a writer found it held */
+        class WriterMutex
+        {
+            ::std::mutex mutex_{};
+            [[no_unique_address]] Counter waits_{};
+
+        public:
+            void lock()
+            {
+                if (!mutex_.try_lock())
+                {
+                    waits_.Add(1U);
+                    mutex_.lock();
+                }
+            }
+            void unlock() { mutex_.unlock(); }
+            uint64_t Waits() const { return waits_.Load(); }
+        };
+
+        /** @brief Epoch based reclamation of whatever publishers may still be using
+         *
+         * A publisher enters the current epoch while it matches and calls subscriptions,
+         * which lets it use raw pointers to snapshots, groups, elements and linkers
+         * without touching their reference counts.  Anything unlinked or replaced is
+         * retired with the current epoch, and it is freed once the epoch has advanced
+         * twice, which can only happen after every publisher which might still see it
+         * has left.  Things retired together are freed in the order they were retired.
+         *
+         * The epoch only ever advances opportunistically, when something is retired or
+         * a publisher leaves while retired objects are waiting, so nothing ever blocks.
+         */
+        class Epochs
+        {
+            struct alignas(64) Slot
+            {
+                ::std::atomic<size_t> entered[2]{};
+            };
+            struct Retired
+            {
+                uint64_t epoch{};
+                void* object{};
+                void (*free)(void*){};
+            };
+
+            ::std::array<Slot, ThreadSlots::slotCount> slots_{};
+            alignas(64)::std::atomic<uint64_t> epoch_{};
+            ::std::atomic<bool> pending_{};
+            ::std::mutex lock_{};
+            ::std::deque<Retired> retired_{};
+            ::std::atomic_flag reclaiming_{};
+            ::std::vector<Retired> expired_{}; ///< reused by whoever is reclaiming, so that it needn't allocate
+
+            void Retire(Retired retired)
+            {
+                {
+                    ::std::scoped_lock<::std::mutex> guard{ lock_ };
+                    retired.epoch = epoch_.load(::std::memory_order_seq_cst);
+                    retired_.push_back(::std::move(retired));
+                    pending_.store(true, ::std::memory_order_relaxed);
+                }
+            }
+
+        public:
+            class Guard
+            {
+                Epochs& epochs_;
+                ::std::atomic<size_t>& entered_;
+                bool reclaim_{};
+
+                static ::std::atomic<size_t>& Enter(Epochs& epochs)
+                {
+                    auto& slot = epochs.slots_[ThreadSlots::Get()];
+                    for (;;)
+                    {
+                        auto epoch = epochs.epoch_.load(::std::memory_order_seq_cst);
+                        auto& entered = slot.entered[epoch & 1U];
+                        entered.fetch_add(1, ::std::memory_order_seq_cst);
+                        if (epochs.epoch_.load(::std::memory_order_seq_cst) == epoch)
+                        {
+                            return entered;
+                        }
+                        entered.fetch_sub(1, ::std::memory_order_seq_cst);
+                    }
+                }
+
+            public:
+                /// @brief Unless told not to reclaim, leaving may free what was retired, which runs destructors
+                explicit Guard(Epochs& epochs, bool reclaim = true) :
+                    epochs_{ epochs }, entered_{ Enter(epochs) }, reclaim_{ reclaim }
+                {
+                }
+                ~Guard()
+                {
+                    entered_.fetch_sub(1, ::std::memory_order_seq_cst);
+                    if (reclaim_ && epochs_.pending_.load(::std::memory_order_relaxed))
+                    {
+                        epochs_.Reclaim();
+                    }
+                }
+                Guard(Guard&&) = delete;
+            };
+
+            Epochs() = default;
+            Epochs(Epochs&&) = delete;
+            ~Epochs()
+            {
+                // freeing may retire more
+                while (!retired_.empty())
+                {
+                    auto retired = retired_.front();
+                    retired_.pop_front();
+                    retired.free(retired.object);
+                }
+            }
+
+            /// @brief Free what's owned once no publisher can see it, with a deleter which needs no state
+            template<typename Type, typename Deleter>
+            void Retire(::std::unique_ptr<Type, Deleter> owned)
+            {
+                static_assert(::std::is_empty_v<Deleter>);
+                if (owned)
+                {
+                    Retire(Retired{ {},
+                                    const_cast<void*>(static_cast<const void*>(owned.release())),
+                                    [](void* object) { Deleter{}(static_cast<Type*>(object)); } });
+                }
+            }
+
+            /** @brief Advance the epoch as far as publishers allow, and free what is safe to free */
+            void Reclaim()
+            {
+                if (reclaiming_.test_and_set(::std::memory_order_acquire))
+                {
+                    return; // another thread is reclaiming, and anything left stays pending
+                }
+                {
+                    ::std::scoped_lock<::std::mutex> guard{ lock_ };
+                    for (auto advance = 0; advance < 2; ++advance)
+                    {
+                        auto epoch = epoch_.load(::std::memory_order_seq_cst);
+                        size_t previous{};
+                        for (const auto& slot : slots_)
+                        {
+                            previous += slot.entered[(epoch + 1) & 1U].load(::std::memory_order_seq_cst);
+                        }
+                        if (previous != 0)
+                        {
+                            break;
+                        }
+                        epoch_.store(epoch + 1, ::std::memory_order_seq_cst);
+                    }
+                    const auto epoch = epoch_.load(::std::memory_order_seq_cst);
+                    while (!retired_.empty() && retired_.front().epoch + 2 <= epoch)
+                    {
+                        expired_.push_back(::std::move(retired_.front()));
+                        retired_.pop_front();
+                    }
+                    pending_.store(!retired_.empty(), ::std::memory_order_relaxed);
+                }
+                // destructors may unsubscribe, which would retire more, so go round again for those
+                auto freed = !expired_.empty();
+                for (auto& retired : expired_)
+                {
+                    retired.free(retired.object);
+                }
+                expired_.clear();
+
+                reclaiming_.clear(::std::memory_order_release);
+                if (freed && pending_.load(::std::memory_order_relaxed))
+                {
+                    Reclaim();
+                }
+            }
+        };
+
+        /** @brief Buffers for the matches of PublishRealtime(), kept by each thread
+         *
+         * There is one buffer for each level of nested publishing, and each keeps its
+         * capacity, so that publishing only allocates when it finds more matches than
+         * ever before on that thread.
+         */
+        class MatchBuffers
+        {
+            using Buffer = ::std::vector<ElementBase*>;
+
+            // a deque, since leases refer to the buffers while deeper ones are added
+            static inline thread_local ::std::deque<Buffer> buffers_{};
+            static inline thread_local size_t depth_{};
+
+        public:
+            /// @brief Make room on the calling thread for the given number of matches, at each of depth levels
+            static void Reserve(size_t matches, size_t depth)
+            {
+                while (buffers_.size() < depth)
+                {
+                    buffers_.emplace_back();
+                }
+                for (auto& buffer : buffers_)
+                {
+                    buffer.reserve(matches);
+                }
+            }
+
+            /** @brief The calling thread's buffer for one publish */
+            class Lease
+            {
+                Buffer& buffer_;
+
+                static Buffer& Take()
+                {
+                    if (depth_ == buffers_.size())
+                    {
+                        buffers_.emplace_back();
+                    }
+                    return buffers_[depth_++];
+                }
+
+            public:
+                Lease() : buffer_{ Take() } {}
+                ~Lease() { --depth_; }
+                Lease(Lease&&) = delete;
+                Buffer& Get() const { return buffer_; }
+            };
+        };
+
+        /** @brief What PublishAsync() does when the queue is full */
+        enum class Overflow
+        {
+            Block,      ///< wait for a worker to make room
+            DropNewest, ///< discard the event being published
+            DropOldest, ///< discard the oldest queued event to make room
+        };
+
+        /** Argument for PubSub constructor to dispatch PublishAsync() events on a pool of worker threads
+         *
+         *     tbd::PubSub pubsub{ tbd::PubSub::Async{ .threads = 2, .capacity = 4096 } };
+         *     pubsub.PublishAsync(Op::ProcessStart, pid, path);
+         */
+        struct Async
+        {
+            unsigned int threads{ 1U };
+            size_t capacity{ 1024U }; ///< rounded up to a power of two
+            Overflow overflow{ Overflow::Block };
+        };
+
+        /** @brief An event queued by PublishAsync(), owning copies of its arguments
+         *
+         * Small events are stored inline so that queueing them doesn't allocate.
+         */
+        class Task
+        {
+            static constexpr size_t inlineSize = 64U;
+
+            struct Ops
+            {
+                void (*dispatch)(void* storage, const Data& data);
+                void (*relocate)(void* from, void* to) noexcept;
+                void (*destroy)(void* storage) noexcept;
+            };
+
+            template<typename Event>
+            static constexpr bool inlined = sizeof(Event) <= inlineSize &&
+                alignof(Event) <= alignof(::std::max_align_t) && ::std::is_nothrow_move_constructible_v<Event>;
+
+            template<typename Event>
+            static Event& Get(void* storage)
+            {
+                if constexpr (inlined<Event>)
+                {
+                    return *::std::launder(static_cast<Event*>(storage));
+                }
+                else
+                {
+                    return **static_cast<Event**>(storage);
+                }
+            }
+
+            template<typename Event>
+            static constexpr Ops ops{
+                [](void* storage, const Data& data) { Get<Event>(storage)(data); },
+                [](void* from, void* to) noexcept
+                {
+                    if constexpr (inlined<Event>)
+                    {
+                        new (to) Event{ ::std::move(Get<Event>(from)) };
+                        Get<Event>(from).~Event();
+                    }
+                    else
+                    {
+                        *static_cast<Event**>(to) = *static_cast<Event**>(from);
+                    }
+                },
+                [](void* storage) noexcept
+                {
+                    if constexpr (inlined<Event>)
+                    {
+                        Get<Event>(storage).~Event();
+                    }
+                    else
+                    {
+                        delete &Get<Event>(storage);
+                    }
+                },
+            };
+
+            const Ops* ops_{};
+            alignas(::std::max_align_t) ::std::byte storage_[inlineSize];
+
+        public:
+            Task() = default;
+            template<typename Event>
+            explicit Task(Event event) : ops_{ &ops<Event> }
+            {
+                if constexpr (inlined<Event>)
+                {
+                    new (storage_) Event{ ::std::move(event) };
+                }
+                else
+                {
+                    *reinterpret_cast<Event**>(storage_) = new Event{ ::std::move(event) };
+                }
+            }
+            Task(const Task&) = delete;
+            Task& operator=(const Task&) = delete;
+            Task(Task&& donor) noexcept : ops_{ ::std::exchange(donor.ops_, nullptr) }
+            {
+                if (ops_)
+                {
+                    ops_->relocate(donor.storage_, storage_);
+                }
+            }
+            Task& operator=(Task&& donor) noexcept
+            {
+                if (this != &donor)
+                {
+                    Reset();
+                    if ((ops_ = ::std::exchange(donor.ops_, nullptr)))
+                    {
+                        ops_->relocate(donor.storage_, storage_);
+                    }
+                }
+                return *this;
+            }
+            ~Task() { Reset(); }
+
+            void Reset() noexcept
+            {
+                if (auto ops = ::std::exchange(ops_, nullptr))
+                {
+                    ops->destroy(storage_);
+                }
+            }
+            void operator()(const Data& data) { ops_->dispatch(storage_, data); }
+        };
+
+        /** @brief Bounded lock-free multi-producer multi-consumer queue
+         *
+         * Each cell carries a sequence number which tells producers and
+         * consumers whose turn it is, so neither side ever takes a lock.
+         */
+        class TaskQueue
+        {
+            struct alignas(64) Cell
+            {
+                ::std::atomic<size_t> sequence{};
+                Task task{};
+            };
+
+            ::std::unique_ptr<Cell[]> cells_;
+            size_t mask_;
+            alignas(64)::std::atomic<size_t> enqueue_{};
+            alignas(64)::std::atomic<size_t> dequeue_{};
+
+        public:
+            explicit TaskQueue(size_t capacity) :
+                cells_{ ::std::make_unique<Cell[]>(::std::bit_ceil(::std::max<size_t>(capacity, 2U))) },
+                mask_{ ::std::bit_ceil(::std::max<size_t>(capacity, 2U)) - 1U }
+            {
+                for (size_t i = 0U; i <= mask_; ++i)
+                {
+                    cells_[i].sequence.store(i, ::std::memory_order_relaxed);
+                }
+            }
+
+            /// @brief Moves from task only if there was room for it
+            bool TryPush(Task& task)
+            {
+                auto pos = enqueue_.load(::std::memory_order_relaxed);
+                for (;;)
+                {
+                    auto& cell = cells_[pos & mask_];
+                    auto seq = cell.sequence.load(::std::memory_order_acquire);
+                    auto diff = static_cast<::std::ptrdiff_t>(seq - pos);
+                    if (diff == 0)
+                    {
+                        if (enqueue_.compare_exchange_weak(pos, pos + 1U, ::std::memory_order_relaxed))
+                        {
+                            cell.task = ::std::move(task);
+                            cell.sequence.store(pos + 1U, ::std::memory_order_release);
+                            return true;
+                        }
+                    }
+                    else if (diff < 0)
+                    {
+                        return false;
+                    }
+                    else
+                    {
+                        pos = enqueue_.load(::std::memory_order_relaxed);
+                    }
+                }
+            }
+
+            bool TryPop(Task& task)
+            {
+                auto pos = dequeue_.load(::std::memory_order_relaxed);
+                for (;;)
+                {
+                    auto& cell = cells_[pos & mask_];
+                    auto seq = cell.sequence.load(::std::memory_order_acquire);
+                    auto diff = static_cast<::std::ptrdiff_t>(seq - (pos + 1U));
+                    if (diff == 0)
+                    {
+                        if (dequeue_.compare_exchange_weak(pos, pos + 1U, ::std::memory_order_relaxed))
+                        {
+                            task = ::std::move(cell.task);
+                            cell.sequence.store(pos + mask_ + 1U, ::std::memory_order_release);
+                            return true;
+                        }
+                    }
+                    else if (diff < 0)
+                    {
+                        return false;
+                    }
+                    else
+                    {
+                        pos = dequeue_.load(::std::memory_order_relaxed);
+                    }
+                }
+            }
+        };
+
+        /** @brief The worker pool which dispatches events queued by PublishAsync()
+         *
+         * Workers only hold a weak reference to the subscription database, and
+         * take a strong one while dispatching, so the last PubSub may be
+         * destroyed by a callback running on a worker.
+         */
+        class Executor
+        {
+            struct Shared
+            {
+                TaskQueue queue;
+                ::std::atomic<unsigned> items{};      ///< bumped for each push, idle workers wait on it
+                ::std::atomic<unsigned> space{};      ///< bumped for each pop, blocked publishers wait on it
+                ::std::atomic<size_t> accepted{};
+                ::std::atomic<size_t> completed{};
+                ::std::atomic<size_t> dropped{};
+                ::std::atomic<bool> stop{};
+
+                explicit Shared(size_t capacity) : queue{ capacity } {}
+
+                bool Pop(Task& task)
+                {
+                    if (!queue.TryPop(task))
+                    {
+                        return false;
+                    }
+                    space.fetch_add(1U, ::std::memory_order_release);
+                    space.notify_one();
+                    return true;
+                }
+                void Complete()
+                {
+                    completed.fetch_add(1U, ::std::memory_order_release);
+                    completed.notify_all();
+                }
+            };
+
+            ::std::shared_ptr<Shared> shared_;
+            ::std::vector<::std::thread> workers_{};
+            Overflow overflow_;
+
+            static void Work(::std::shared_ptr<Shared> shared, ::std::weak_ptr<Data> weak)
+            {
+                Task task{};
+                while (!shared->stop.load(::std::memory_order_acquire))
+                {
+                    auto seen = shared->items.load(::std::memory_order_acquire);
+                    if (!shared->Pop(task))
+                    {
+                        shared->items.wait(seen, ::std::memory_order_acquire);
+                        continue;
+                    }
+                    auto data = weak.lock();
+                    do
+                    {
+                        if (data)
+                        {
+                            task(*data);
+                        }
+                        task.Reset();
+                        shared->Complete();
+                    } while (!shared->stop.load(::std::memory_order_relaxed) && shared->Pop(task));
+                    // this may destroy the PubSub, and the executor with it
+                    data.reset();
+                }
+            }
+
+        public:
+            Executor(const Async& options, ::std::weak_ptr<Data> data) :
+                shared_{ ::std::make_shared<Shared>(options.capacity) }, overflow_{ options.overflow }
+            {
+                for (auto i = 0U; i < ::std::max(options.threads, 1U); ++i)
+                {
+                    workers_.emplace_back(&Executor::Work, shared_, data);
+                }
+            }
+            Executor(const Executor&) = delete;
+            Executor& operator=(const Executor&) = delete;
+            ~Executor()
+            {
+                shared_->stop.store(true, ::std::memory_order_release);
+                shared_->items.fetch_add(1U, ::std::memory_order_release);
+                shared_->items.notify_all();
+                shared_->space.fetch_add(1U, ::std::memory_order_release);
+                shared_->space.notify_all();
+                for (auto& worker : workers_)
+                {
+                    if (worker.get_id() == ::std::this_thread::get_id())
+                    {
+                        worker.detach();
+                    }
+                    else
+                    {
+                        worker.join();
+                    }
+                }
+            }
+
+            /// @brief Returns false if the task was dropped
+            bool Push(Task task)
+            {
+                auto& shared = *shared_;
+                for (;;)
+                {
+                    auto seen = shared.space.load(::std::memory_order_acquire);
+                    if (shared.stop.load(::std::memory_order_acquire))
+                    {
+                        return false;
+                    }
+                    if (shared.queue.TryPush(task))
+                    {
+                        break;
+                    }
+                    if (overflow_ == Overflow::DropNewest)
+                    {
+                        shared.dropped.fetch_add(1U, ::std::memory_order_relaxed);
+                        return false;
+                    }
+                    if (overflow_ == Overflow::DropOldest)
+                    {
+                        Task oldest{};
+                        if (shared.Pop(oldest))
+                        {
+                            shared.dropped.fetch_add(1U, ::std::memory_order_relaxed);
+                            shared.Complete();
+                        }
+                        continue;
+                    }
+                    shared.space.wait(seen, ::std::memory_order_acquire);
+                }
+                shared.accepted.fetch_add(1U, ::std::memory_order_release);
+                shared.items.fetch_add(1U, ::std::memory_order_release);
+                shared.items.notify_one();
+                return true;
+            }
+
+            /// @brief Wait until as many events as have been queued so far were dispatched or dropped
+            void Flush() const
+            {
+                auto target = shared_->accepted.load(::std::memory_order_acquire);
+                for (auto done = shared_->completed.load(::std::memory_order_acquire); done < target;
+                     done = shared_->completed.load(::std::memory_order_acquire))
+                {
+                    shared_->completed.wait(done, ::std::memory_order_acquire);
+                }
+            }
+
+            size_t Dropped() const { return shared_->dropped.load(::std::memory_order_relaxed); }
+        };
+
+        /** @brief A thread which removes the elements of detached linkers
+         *
+         * It's started when first needed.  Whatever is queued when it stops is still
+         * completed, but there's nothing left to remove once the PubSub has gone.
+         */
+        class Reaper
+        {
+            struct Job
+            {
+                ::std::shared_ptr<Linker> linker{};
+                ElementBase* last{};
+                ::std::function<void()> onDone{};
+            };
+            struct Shared
+            {
+                ::std::mutex lock{};
+                ::std::condition_variable wake{};
+                ::std::deque<Job> jobs{};
+                bool stop{};
+            };
+
+            ::std::shared_ptr<Shared> shared_{ ::std::make_shared<Shared>() };
+            ::std::thread thread_{};
+
+            static void Work(::std::shared_ptr<Shared> shared)
+            {
+                ::std::deque<Job> jobs{};
+                for (;;)
+                {
+                    {
+                        ::std::unique_lock<::std::mutex> guard{ shared->lock };
+                        shared->wake.wait(guard, [&shared] { return shared->stop || !shared->jobs.empty(); });
+                        if (shared->jobs.empty())
+                        {
+                            return;
+                        }
+                        ::std::swap(jobs, shared->jobs);
+                    }
+                    for (auto& job : jobs)
+                    {
+                        // this may destroy the PubSub, and the reaper with it
+                        job.linker->Remove(*job.last);
+                        if (job.onDone)
+                        {
+                            job.onDone();
+                        }
+                    }
+                    jobs.clear();
+                }
+            }
+
+        public:
+            Reaper() : thread_{ &Reaper::Work, shared_ } {}
+            Reaper(const Reaper&) = delete;
+            Reaper& operator=(const Reaper&) = delete;
+            ~Reaper()
+            {
+                {
+                    ::std::scoped_lock<::std::mutex> guard{ shared_->lock };
+                    shared_->stop = true;
+                }
+                shared_->wake.notify_all();
+                if (thread_.get_id() == ::std::this_thread::get_id())
+                {
+                    thread_.detach();
+                }
+                else
+                {
+                    thread_.join();
+                }
+            }
+
+            void Push(::std::shared_ptr<Linker> linker, ElementBase& last, ::std::function<void()> onDone)
+            {
+                {
+                    ::std::scoped_lock<::std::mutex> guard{ shared_->lock };
+                    shared_->jobs.push_back(Job{ ::std::move(linker), &last, ::std::move(onDone) });
+                }
+                shared_->wake.notify_one();
+            }
+        };
+
+        /** @brief Numbers each event while its callbacks are called, so that a callback can tell events apart
+         *
+         * Ids are unique across threads, since each thread takes them from a shared
+         * counter in blocks.  An event published from a callback has an id of its own
+         * until it has been dispatched.
+         */
+        class Dispatching
+        {
+            static constexpr uint64_t blockSize = uint64_t{ 1U } << 16U;
+
+            struct Ids
+            {
+                uint64_t current{};
+                uint64_t next{};
+                uint64_t end{};
+            };
+            static Ids& ThreadIds()
+            {
+                thread_local Ids ids{};
+                return ids;
+            }
+            static inline ::std::atomic<uint64_t> blocks_{};
+
+            uint64_t previous_{};
+
+        public:
+            Dispatching()
+            {
+                auto& ids = ThreadIds();
+                if (ids.next == ids.end)
+                {
+                    ids.next = blocks_.fetch_add(1U, ::std::memory_order_relaxed) * blockSize + 1U;
+                    ids.end = ids.next + blockSize - 1U;
+                }
+                previous_ = ::std::exchange(ids.current, ids.next++);
+            }
+            ~Dispatching() { ThreadIds().current = previous_; }
+            Dispatching(const Dispatching&) = delete;
+            Dispatching& operator=(const Dispatching&) = delete;
+
+            /// @brief The event being dispatched on this thread, or zero
+            static uint64_t Current() { return ThreadIds().current; }
+        };
+
+        /** @brief The number of subscriptions for each call signature, which may be read without a lock
+         *
+         * Counts are indexed by helpers::SignatureId() in lazily allocated chunks.
+         * Signatures beyond the table are always reported as subscribed.
+         */
+        class SignatureCounts
+        {
+            static constexpr size_t chunkSize = 256U;
+            using Chunk = ::std::array<::std::atomic<size_t>, chunkSize>;
+
+            ::std::array<::std::atomic<Chunk*>, 256U> chunks_{};
+
+        public:
+            SignatureCounts() = default;
+            SignatureCounts(const SignatureCounts&) = delete;
+            SignatureCounts& operator=(const SignatureCounts&) = delete;
+            ~SignatureCounts()
+            {
+                for (auto& chunk : chunks_)
+                {
+                    delete chunk.load(::std::memory_order_relaxed);
+                }
+            }
+
+            bool Any(size_t id) const
+            {
+                if (id >= chunkSize * chunks_.size())
+                {
+                    return true;
+                }
+                auto chunk = chunks_[id / chunkSize].load(::std::memory_order_acquire);
+                return chunk && (*chunk)[id % chunkSize].load(::std::memory_order_relaxed) != 0U;
+            }
+
+            /// @brief Subscriptions and waiters are counted under different locks, so chunks are installed atomically
+            void Add(size_t id, ::std::ptrdiff_t delta)
+            {
+                if (id >= chunkSize * chunks_.size())
+                {
+                    return;
+                }
+                auto& slot = chunks_[id / chunkSize];
+                auto chunk = slot.load(::std::memory_order_acquire);
+                if (!chunk)
+                {
+                    auto fresh = ::std::make_unique<Chunk>();
+                    if (slot.compare_exchange_strong(chunk, fresh.get(), ::std::memory_order_acq_rel))
+                    {
+                        chunk = fresh.release();
+                    }
+                }
+                (*chunk)[id % chunkSize].fetch_add(static_cast<size_t>(delta), ::std::memory_order_relaxed);
+            }
+        };
+
+        class Term
+        {
+            ::std::weak_ptr<Linker> linker_{};
+
+        public:
+            Term() = default;
+            Term(::std::weak_ptr<Linker> linker) : linker_{ ::std::move(linker) } {}
+
+            void Terminate() const
+            {
+                if (auto linker = linker_.lock())
+                {
+                    linker->Destroy();
+                }
+            }
+        };
+
+        class Anchor
+        {
+            ::std::shared_ptr<Linker> linker_{};
+
+        public:
+            Anchor() = default;
+            explicit Anchor(::std::shared_ptr<Linker> linker) : linker_{ ::std::move(linker) } {}
+            virtual ~Anchor()
+            {
+                if (auto linker = ::std::move(linker_))
+                {
+                    linker->Destroy();
+                }
+            }
+            Anchor& operator=(::std::nullptr_t)
+            {
+                auto tmp = ::std::move(*this);
+                return *this;
+            }
+            Anchor(Anchor&&) = default;
+            Anchor& operator=(Anchor&&) = default;
+            Anchor(const Anchor&) = delete;
+            Anchor& operator=(const Anchor&) = delete;
+            explicit operator bool() const { return linker_ && *linker_; }
+            size_t size() const { return linker_ ? linker_->size() : 0UL; }
+            Term GetTerminator() const { return Term{ linker_ }; }
+
+            /** @brief Unsubscribe without waiting for callbacks in progress
+             *
+             * Nothing more is dispatched to the anchor's subscriptions once this returns,
+             * but callbacks already in progress may still be running.  They are removed
+             * by a background thread once those have finished, and then onDone is called
+             * on that thread.  The anchor is left empty.
+             *
+             * If the PubSub is destroyed before the removal is done, ~PubSub may return
+             * before the callbacks and onDone are destroyed, so their captures must not
+             * refer to anything which ends with the PubSub.
+             */
+            void DetachAsync(::std::function<void()> onDone = {})
+            {
+                if (auto linker = ::std::move(linker_))
+                {
+                    Linker::DetachAsync(::std::move(linker), ::std::move(onDone));
+                }
+                else if (onDone)
+                {
+                    onDone();
+                }
+            }
+
+            template<typename Func, typename... Args>
+            [[nodiscard]] Anchor Subscribe(Func func, Args&&... args)
+            {
+                Add(::std::move(func), ::std::forward<Args>(args)...);
+                return Anchor{ ::std::move(linker_) };
+            }
+
+            template<typename Func, typename... Args>
+            Anchor& Add(Func func, Args&&... args)
+            {
+                if (!linker_)
+                {
+                    throw ::std::runtime_error{ "Invalid anchor" };
+                }
+
+                if (auto data = linker_->GetData().lock())
+                {
+                    ::std::unique_ptr<ElementBase> sel{ new (data->GetMemory()->Resource())
+                                                            Select<Func, helpers::SelType<Func, Args...>>{
+                                                                ::std::move(func), ::std::forward<Args>(args)... } };
+
+                    data->AddElement(linker_, ::std::move(sel));
+                }
+
+                return *this;
+            }
+        };
+
+        template<typename Func, typename SelectType>
+        class Select : public Selection<helpers::GetTuple_t<Func>, SelectType>
+        {
+            using TupleType = helpers::GetTuple_t<Func>;
+            static inline constexpr ::std::size_t CallArgCount = ::std::tuple_size<TupleType>();
+
+            ::std::optional<Func> func_; ///< discarded once removed, since the element itself may be kept for a while
+
+        public:
+            void* GetFunc() override { return static_cast<void*>(&*func_); }
+
+            void Execute(const void* args) override
+            {
+                auto& params = *static_cast<const TupleType*>(args);
+                ::std::apply(*func_, params);
+            }
+            void DiscardFunc() override { func_.reset(); }
+
+            // std::type_index ReturnType() const override { return std::type_index{typeid(GetRet<Func>)}; }
+            ::std::type_index ArgumentType() const override { return ::std::type_index{ typeid(TupleType) }; }
+            ::std::type_index SelectArgs() const override { return ::std::type_index{ typeid(SelectType) }; }
+
+            template<typename Lambda, typename... Args>
+            explicit Select(Lambda&& func, Args&&... args) :
+                Selection<TupleType, SelectType>{ ::std::in_place, ::std::forward<Args>(args)... },
+                func_{ ::std::in_place, ::std::move(func) }
+            {
+            }
+        };
+
+        template<typename Lambda, typename... Args>
+        Select(Lambda f, Args&&... a) -> Select<Lambda, helpers::SelType<Lambda, Args...>>;
+
+        static inline std::string ShowTupleArgs(std::type_index id)
+        {
+            std::string tup = Demangle(id).ToString();
+            if (tup.starts_with("std::tuple<"))
+            {
+                return tup.substr(11, tup.size() - 12);
+            }
+            return tup;
+        }
+
+
+        /// @brief Each prototype checks all GroupSelectors, but we need to index them to insert quickly
+
+        /** @brief The subscriptions of one call signature, as found by Statistics() */
+        struct SignatureStats
+        {
+            ::std::type_index signature;
+            size_t subscriptions{};
+            ::std::vector<::std::pair<::std::type_index, size_t>> groups{}; ///< the size of each selector group
+        };
+
+        /** Tag for PubSub constructor to force it to remove empty elements from
+         * the subscription database
+         * 
+         * This is generally not recommended, because the number of empty
+         * elements is set at compile time and is unlikely to be significant.
+         */
+        struct RemoveEmptySets{};
+
+        /** @brief A one-shot wait for an event, which Data keeps on a list rather than in a group
+         *
+         * Waiting and giving up only take the list's own lock, so they neither allocate
+         * an element nor take the data lock, unlike subscribing.  Each publish of the
+         * call signature checks the list after calling the subscriptions.
+         */
+        class Waiter
+        {
+            friend class Data;
+
+            enum class State
+            {
+                Idle,
+                Waiting,
+                Firing ///< taken off the list by a publisher, which hasn't yet called Fired()
+            };
+
+            ::std::type_index argType_;
+            size_t signatureId_{};
+            Waiter* previous_{};
+            Waiter* next_{};
+            State state_{}; ///< guarded by the list's lock
+
+        protected:
+            Waiter(::std::type_index argType, size_t signatureId) : argType_{ argType }, signatureId_{ signatureId } {}
+            ~Waiter() = default;
+
+        public:
+            Waiter(Waiter&&) = delete;
+            virtual bool Accepts(const void* args) const = 0;
+            /// @brief Called once, outside the lock, and must call Data::Fired() before the waiter may be destroyed
+            virtual void Fire(const void* args) = 0;
+        };
+
+        class Data
+        {
+            // declared first, so that it outlives every element
+            ::std::shared_ptr<Memory> memory_{};
+            Database_t database_{}; ///< only used by writers, under lock_
+            Published<Directory> directory_{};
+            mutable WriterMutex lock_{};
+            // declared after the database, so that whatever was retired goes first
+            mutable Epochs epochs_{};
+            ::std::ostream* debugStream_{};
+            bool removeEmptySets_{false};
+
+            ::std::mutex removalsLock_{};
+            ::std::vector<ElementBase*> removals_{}; ///< the last element of each stopped linker, queued by ReleaseNodes()
+            ::std::mutex removing_{};                ///< held by the thread applying the removals
+            ::std::vector<ElementBase*> applying_{};
+            // reused under lock_
+            Runs::Replaced replaced_{};
+            ::std::vector<Prototype*> changed_{};
+            ::std::vector<::std::unique_ptr<Runs>> emptied_{};
+            ::std::atomic<uint64_t> additions_{}; ///< bumped for each subscription added, once it's published
+            mutable SignatureCounts subscribed_{}; ///< counts waiters too, so that publishing checks for them
+            mutable ::std::mutex waitersLock_{};
+            mutable ::std::condition_variable waitersFired_{};
+            mutable ::std::unordered_map<::std::type_index, Waiter*> waiters_{}; ///< the most recent of each list
+            mutable ::std::atomic<size_t> waiting_{};
+            [[no_unique_address]] Counter linkerWaits_{};
+            /// @brief Totals over the database, kept up to date by the writers
+            struct
+            {
+                ::std::atomic<size_t> callTypes{};
+                ::std::atomic<size_t> selectors{}; ///< distinct SelectTypes, whichever groups they share
+                ::std::atomic<size_t> groups{};
+                ::std::atomic<size_t> subscriptions{};
+                ::std::atomic<size_t> anchors{};
+            } counts_{};
+            // declared last, so the workers are stopped before anything they use is destroyed
+            ::std::once_flag reaperStarted_{};
+            ::std::unique_ptr<Reaper> reaper_{};
+            ::std::unique_ptr<Executor> executor_{};
+
+            using ScopedLock = ::std::scoped_lock<WriterMutex>;
+
+            /// @brief Caller must hold waitersLock_
+            void Unlink(Waiter& waiter) const
+            {
+                if (waiter.next_)
+                {
+                    waiter.next_->previous_ = waiter.previous_;
+                }
+                if (waiter.previous_)
+                {
+                    waiter.previous_->next_ = waiter.next_;
+                }
+                else if (waiter.next_)
+                {
+                    waiters_.find(waiter.argType_)->second = waiter.next_;
+                }
+                else
+                {
+                    waiters_.erase(waiter.argType_);
+                }
+                waiting_.fetch_sub(1U, ::std::memory_order_relaxed);
+                subscribed_.Add(waiter.signatureId_, -1);
+            }
+
+            /// @brief Caller must hold an Epochs::Guard, for as long as it uses the results
+            template<typename Type>
+            static void Match(const Prototype& prototype, const Type& argTuple, MatchResults<ElementBase*>& winners)
+            {
+                Stopwatch stopwatch{};
+                if (auto snapshot = prototype.snapshot.Load())
+                {
+                    for (auto group : snapshot->groups)
+                    {
+                        group->Match(static_cast<const void*>(&argTuple), winners);
+                    }
+                }
+                prototype.metrics.Record(stopwatch.Elapsed(), winners.begin() != winners.end());
+            }
+            template<typename Type>
+            static MatchResults<ElementBase*> Match(const Prototype& prototype, const Type& argTuple)
+            {
+                MatchResults<ElementBase*> winners{};
+                Match(prototype, argTuple, winners);
+                return winners;
+            }
+
+            /// @brief Caller must hold an Epochs::Guard, for as long as it uses the prototype
+            const Prototype* Find(::std::type_index argType) const
+            {
+                if (auto directory = directory_.Load())
+                {
+                    if (auto prototype = directory->find(argType); prototype != directory->end())
+                    {
+                        return prototype->second;
+                    }
+                }
+                return nullptr;
+            }
+
+            /// @brief Caller must hold lock_, and publishes the directory again if the prototype is new
+            Prototype& PrototypeFor(::std::type_index argType)
+            {
+                auto& prototype = database_[argType];
+                if (!prototype)
+                {
+                    prototype = ::std::make_unique<Prototype>();
+                    PublishDirectory();
+                }
+                return *prototype;
+            }
+
+            /// @brief Caller must hold lock_
+            void PublishDirectory()
+            {
+                auto directory = ::std::make_unique<Directory>();
+                for (const auto& [argType, prototype] : database_)
+                {
+                    directory->emplace(argType, prototype.get());
+                }
+                epochs_.Retire(directory_.Exchange(::std::move(directory)));
+            }
+
+            /// @brief Caller must hold lock_, having changed the prototype's runs
+            void PublishSnapshot(Prototype& prototype)
+            {
+                auto snapshot = ::std::make_unique<Snapshot>();
+                for (const auto& [key, runs] : prototype.selectors)
+                {
+                    runs->Collect(snapshot->groups);
+                    snapshot->runs.emplace_back(key, runs.get());
+                }
+                if (snapshot->runs.empty())
+                {
+                    snapshot.reset();
+                }
+                epochs_.Retire(prototype.snapshot.Exchange(::std::move(snapshot)));
+            }
+
+            /// @brief Caller must hold lock_, and must have published what replaced them
+            void RetireReplaced()
+            {
+                for (auto& group : replaced_.groups)
+                {
+                    epochs_.Retire(::std::move(group));
+                }
+                for (auto element : replaced_.elements)
+                {
+                    epochs_.Retire(::std::unique_ptr<ElementBase>{ element });
+                }
+                replaced_.groups.clear();
+                replaced_.elements.clear();
+            }
+
+        public:
+            Data() : memory_{ ::std::make_shared<Memory>() } {}
+            explicit Data(::std::ostream& debugStream) : memory_{ ::std::make_shared<Memory>() }, debugStream_{ &debugStream } {}
+            explicit Data(PubSub::RemoveEmptySets) : memory_{ ::std::make_shared<Memory>() }, removeEmptySets_{ true } {}
+            explicit Data(::std::pmr::memory_resource& resource) : memory_{ ::std::make_shared<Memory>(resource) } {}
+
+            const ::std::shared_ptr<Memory>& GetMemory() const { return memory_; }
+
+            /// @brief Called once, just after construction, since the workers need a weak reference to us
+            void StartExecutor(const ::std::shared_ptr<Data>& self, const Async& options)
+            {
+                executor_ = ::std::make_unique<Executor>(options, self);
+            }
+            Executor* GetExecutor() const { return executor_.get(); }
+
+            /** @brief Add an element to its runs, and publish the prototype's new snapshot
+             *
+             * Publishers never wait for this, since they only ever see complete snapshots.
+             */
+            void AddElement(::std::shared_ptr<Linker>& linker, ::std::unique_ptr<ElementBase> base)
+            {
+                {
+                    ScopedLock guard{ lock_ };
+                    auto argType = base->ArgumentType();
+                    auto& prototype = PrototypeFor(argType);
+                    auto& perPrototype = prototype.selectors;
+                    if (++prototype.selectTypes[base->SelectArgs()] == 1U)
+                    {
+                        counts_.selectors.fetch_add(1U, ::std::memory_order_relaxed);
+                    }
+                    auto& runs = perPrototype[base->GroupKey()];
+                    if (!runs)
+                    {
+                        runs = ::std::make_unique<Runs>();
+                        counts_.groups.fetch_add(1U, ::std::memory_order_relaxed);
+                        if (perPrototype.size() == 1U)
+                        {
+                            counts_.callTypes.fetch_add(1U, ::std::memory_order_relaxed);
+                        }
+                    }
+                    auto& element = *base.release();
+                    if (Linker::Remember(linker, *runs, element))
+                    {
+                        counts_.anchors.fetch_add(1U, ::std::memory_order_relaxed);
+                    }
+                    runs->Add(element, replaced_);
+                    PublishSnapshot(prototype);
+                    RetireReplaced();
+                    counts_.subscriptions.fetch_add(1U, ::std::memory_order_relaxed);
+                    additions_.fetch_add(1U, ::std::memory_order_release);
+                    subscribed_.Add(element.SignatureId(), 1);
+                    if (debugStream_)
+                    {
+                        *debugStream_ << "added : " << Demangle(argType) << "\n";
+                    }
+                }
+                // what the new snapshot replaced can usually be freed at once
+                epochs_.Reclaim();
+            }
+
+            /** @brief Each publisher holds one of these while it uses the results of GetMatches() */
+            Epochs& GetEpochs() const { return epochs_; }
+
+            template<typename Type>
+            MatchResults<ElementBase*> GetMatches(Type argTuple) const
+            {
+                if (auto prototype = Find(::std::type_index{ typeid(Type) }))
+                {
+                    return Match(*prototype, argTuple);
+                }
+                else if (debugStream_)
+                {
+                    *debugStream_ << "no subscriptions for " << Demangle(typeid(Type)) << "\n";
+                }
+                return {};
+            }
+
+            /** @brief Match a batch of event tuples while resolving the prototype once
+             *
+             * @return the number of subscriptions added so far; once Additions() differs the
+             * matches may be missing new subscriptions
+             */
+            template<typename Type, typename It>
+            uint64_t GetMatches(It first, It last, ::std::vector<MatchResults<ElementBase*>>& matches) const
+            {
+                matches.clear();
+                // read before the snapshot, which is published before the count is bumped
+                auto additions = additions_.load(::std::memory_order_acquire);
+                if (auto prototype = Find(::std::type_index{ typeid(Type) }))
+                {
+                    for (; first != last; ++first)
+                    {
+                        matches.push_back(Match(*prototype, helpers::AsArgTuple(*first)));
+                    }
+                }
+                else
+                {
+                    matches.resize(static_cast<size_t>(::std::distance(first, last)));
+                    if (debugStream_)
+                    {
+                        *debugStream_ << "no subscriptions for " << Demangle(typeid(Type)) << "\n";
+                    }
+                }
+                return additions;
+            }
+            uint64_t Additions() const { return additions_.load(::std::memory_order_acquire); }
+
+            /** @brief Append the matches to results given by the caller, without writing debug output */
+            template<typename Type>
+            void GetMatches(const Type& argTuple, MatchResults<ElementBase*>& winners) const
+            {
+                if (auto prototype = Find(::std::type_index{ typeid(Type) }))
+                {
+                    Match(*prototype, argTuple, winners);
+                }
+            }
+
+            /** @brief Lock-free check for any subscription to a call signature */
+            bool HasSubscribers(size_t signatureId) const { return subscribed_.Any(signatureId); }
+
+            /// @brief Whether publishing a signature could do anything, including writing debug output
+            bool MayPublish(size_t signatureId) const { return debugStream_ || subscribed_.Any(signatureId); }
+
+            /** @brief Find matches within a prototype which has already been resolved by Pin() */
+            template<typename Type>
+            MatchResults<ElementBase*> GetMatches(const Prototype& prototype, Type argTuple) const
+            {
+                return Match(prototype, argTuple);
+            }
+
+            /** @brief Resolve the prototype for a call signature, and keep it in the database
+             *
+             * The prototype is retained, even when empty, until a matching Unpin().
+             */
+            const Prototype* Pin(::std::type_index argType)
+            {
+                ScopedLock guard{ lock_ };
+                auto& prototype = PrototypeFor(argType);
+                ++prototype.publishers;
+                return &prototype;
+            }
+
+            void Unpin(const Prototype* prototype)
+            {
+                ScopedLock guard{ lock_ };
+                --const_cast<Prototype*>(prototype)->publishers;
+            }
+
+            /// @brief Count one subscription fewer of the element's SelectType, under lock_
+            void ForgetSelectType(Prototype& prototype, const ElementBase& element)
+            {
+                auto& selectTypes = prototype.selectTypes;
+                auto selectType = selectTypes.find(element.SelectArgs());
+                if (--selectType->second == 0U && removeEmptySets_)
+                {
+                    selectTypes.erase(selectType);
+                    counts_.selectors.fetch_sub(1U, ::std::memory_order_relaxed);
+                }
+            }
+
+            /** @brief Flag a removed element, and take it out of its runs, under lock_
+             *
+             * Publishers may see the element until its runs are next rebuilt, but they skip
+             * it from now on, so its callback is discarded as soon as none can be calling it.
+             */
+            void Remove(ElementBase& element)
+            {
+                element.removed_.store(true, ::std::memory_order_seq_cst);
+                epochs_.Retire(ElementBase::Discarded{ &element });
+                subscribed_.Add(element.SignatureId(), -1);
+                counts_.subscriptions.fetch_sub(1U, ::std::memory_order_relaxed);
+                auto& prototype = *database_.find(element.ArgumentType())->second;
+                ForgetSelectType(prototype, element);
+                auto& runs = *element.runs_;
+                auto replaced = replaced_.groups.size();
+                runs.Remove(replaced_);
+                auto changed = replaced_.groups.size() != replaced;
+                if (removeEmptySets_ && runs.empty())
+                {
+                    changed = true;
+                    auto& selectors = prototype.selectors;
+                    auto emptied = selectors.find(element.GroupKey());
+                    // a publisher may still be calling an element which was in the runs
+                    emptied_.push_back(::std::move(emptied->second));
+                    selectors.erase(emptied);
+                    counts_.groups.fetch_sub(1U, ::std::memory_order_relaxed);
+                    if (selectors.empty())
+                    {
+                        counts_.callTypes.fetch_sub(1U, ::std::memory_order_relaxed);
+                    }
+                }
+                if (changed && ::std::ranges::find(changed_, &prototype) == changed_.end())
+                {
+                    changed_.push_back(&prototype);
+                }
+            }
+
+
+            /// @brief Apply the queued removals, unless another thread has already done so
+            void ApplyRemovals()
+            {
+                ::std::scoped_lock<::std::mutex> removing{ removing_ };
+                {
+                    ::std::scoped_lock<::std::mutex> guard{ removalsLock_ };
+                    ::std::swap(applying_, removals_);
+                }
+                if (applying_.empty())
+                {
+                    return;
+                }
+                ScopedLock guard{ lock_ };
+                for (auto last : applying_)
+                {
+                    // the elements were linked under lock_, from the oldest after last
+                    for (auto element = last->next_;; element = element->next_)
+                    {
+                        Remove(*element);
+                        if (element == last)
+                        {
+                            break;
+                        }
+                    }
+                    counts_.anchors.fetch_sub(1U, ::std::memory_order_relaxed);
+                }
+                applying_.clear();
+                for (auto prototype : changed_)
+                {
+                    PublishSnapshot(*prototype);
+                }
+                changed_.clear();
+                if (!emptied_.empty())
+                {
+                    ::std::vector<::std::unique_ptr<Prototype>> erased{};
+                    for (auto prototype = database_.begin(); prototype != database_.end();)
+                    {
+                        if (prototype->second->selectors.empty() && prototype->second->publishers == 0U)
+                        {
+                            erased.push_back(::std::move(prototype->second));
+                            prototype = database_.erase(prototype);
+                        }
+                        else
+                        {
+                            ++prototype;
+                        }
+                    }
+                    if (!erased.empty())
+                    {
+                        PublishDirectory();
+                    }
+                    for (auto& prototype : erased)
+                    {
+                        epochs_.Retire(::std::move(prototype));
+                    }
+                }
+                RetireReplaced();
+                for (auto& runs : emptied_)
+                {
+                    epochs_.Retire(::std::move(runs));
+                }
+                emptied_.clear();
+            }
+
+            /// @brief Have a background thread remove the stopped elements of a linker
+            void Reap(::std::shared_ptr<Linker> linker, ElementBase& last, ::std::function<void()> onDone)
+            {
+                ::std::call_once(reaperStarted_, [this] { reaper_ = ::std::make_unique<Reaper>(); });
+                reaper_->Push(::std::move(linker), last, ::std::move(onDone));
+            }
+
+            void Retire(Linker::Owned linker)
+            {
+                epochs_.Retire(::std::move(linker));
+                epochs_.Reclaim();
+            }
+
+            /** @brief Remove the elements of a stopped linker, and retire them
+             *
+             * Removals are queued, and whichever thread gets to apply them applies all
+             * of those queued, so removals from many threads share the lock and each
+             * prototype's new snapshot.  Publishers never wait for them.  Memory is
+             * reclaimed afterwards, outside the lock.  The caller's removal has been
+             * applied once this returns.
+             */
+            void ReleaseNodes(ElementBase& last, bool waited = false)
+            {
+                linkerWaits_.Add(waited ? 1U : 0U);
+                {
+                    ::std::scoped_lock<::std::mutex> guard{ removalsLock_ };
+                    removals_.push_back(&last);
+                }
+                ApplyRemovals();
+                // destructors may unsubscribe, so this must not hold removing_
+                epochs_.Reclaim();
+            }
+
+            /// @brief Put a waiter on the list for its call signature, where the next matching publish finds it
+            void Wait(Waiter& waiter)
+            {
+                ::std::scoped_lock<::std::mutex> guard{ waitersLock_ };
+                auto& last = waiters_[waiter.argType_];
+                waiter.previous_ = nullptr;
+                waiter.next_ = ::std::exchange(last, &waiter);
+                if (waiter.next_)
+                {
+                    waiter.next_->previous_ = &waiter;
+                }
+                waiter.state_ = Waiter::State::Waiting;
+                waiting_.fetch_add(1U, ::std::memory_order_relaxed);
+                subscribed_.Add(waiter.signatureId_, 1);
+            }
+
+            /** @brief Take a waiter off its list, or wait for a publisher which has taken it to call Fired()
+             *
+             * Must not be called from within the waiter's own Fire().
+             */
+            void Cancel(Waiter& waiter) const
+            {
+                ::std::unique_lock<::std::mutex> guard{ waitersLock_ };
+                if (waiter.state_ == Waiter::State::Waiting)
+                {
+                    Unlink(waiter);
+                    waiter.state_ = Waiter::State::Idle;
+                }
+                waitersFired_.wait(guard, [&waiter] { return waiter.state_ != Waiter::State::Firing; });
+            }
+
+            /// @brief Called by a waiter's Fire(), after which the waiter may be destroyed
+            void Fired(Waiter& waiter) const
+            {
+                ::std::scoped_lock<::std::mutex> guard{ waitersLock_ };
+                waiter.state_ = Waiter::State::Idle;
+                waitersFired_.notify_all();
+            }
+
+            /** @brief Fire the waiters which accept an event, each of them once, from the oldest
+             *
+             * They're taken off the list under its lock, and fired after it's released.
+             */
+            template<typename Type>
+            void Wake(const Type& argTuple) const
+            {
+                if (waiting_.load(::std::memory_order_relaxed) == 0U)
+                {
+                    return;
+                }
+                Waiter* woken{};
+                {
+                    ::std::scoped_lock<::std::mutex> guard{ waitersLock_ };
+                    auto list = waiters_.find(::std::type_index{ typeid(Type) });
+                    if (list == waiters_.end())
+                    {
+                        return;
+                    }
+                    for (auto waiter = list->second; waiter;)
+                    {
+                        auto next = waiter->next_;
+                        if (waiter->Accepts(&argTuple))
+                        {
+                            Unlink(*waiter);
+                            waiter->state_ = Waiter::State::Firing;
+                            waiter->next_ = ::std::exchange(woken, waiter);
+                        }
+                        waiter = next;
+                    }
+                }
+                while (woken)
+                {
+                    // firing may destroy the waiter
+                    ::std::exchange(woken, woken->next_)->Fire(&argTuple);
+                }
+            }
+
+            size_t WaiterCount() const { return waiting_.load(::std::memory_order_relaxed); }
+
+            /// @brief Prototypes with at least one selector group; prototypes pinned only by a Publisher have none
+            size_t CallTypes() const { return counts_.callTypes.load(::std::memory_order_relaxed); }
+            size_t SelectorCount() const { return counts_.selectors.load(::std::memory_order_relaxed); }
+            size_t GroupCount() const { return counts_.groups.load(::std::memory_order_relaxed); }
+            size_t SubscriptionCount() const { return counts_.subscriptions.load(::std::memory_order_relaxed); }
+            size_t AnchorCount() const { return counts_.anchors.load(::std::memory_order_relaxed); }
+
+            /** @brief A copy of each prototype's groups and their sizes
+             *
+             * Read like a publisher reads, from the published directory and snapshots
+             * under an epoch guard, with each group's atomic count, so no lock is taken.
+             * A subscribe in progress may or may not be counted yet.
+             */
+            ::std::vector<SignatureStats> Statistics() const
+            {
+                ::std::vector<SignatureStats> result{};
+                Epochs::Guard guard{ epochs_ };
+                auto directory = directory_.Load();
+                if (!directory)
+                {
+                    return result;
+                }
+                result.reserve(directory->size());
+                for (const auto& [signature, prototype] : *directory)
+                {
+                    auto& stats = result.emplace_back(SignatureStats{ signature });
+                    if (auto snapshot = prototype->snapshot.Load())
+                    {
+                        stats.groups.reserve(snapshot->runs.size());
+                        for (const auto& [key, runs] : snapshot->runs)
+                        {
+                            stats.groups.emplace_back(key, runs->size());
+                            stats.subscriptions += runs->size();
+                        }
+                    }
+                }
+                return result;
+            }
+
+            MetricsSnapshot Metrics() const
+            {
+                MetricsSnapshot result{};
+                if constexpr (helpers::metrics)
+                {
+                    {
+                        ::std::scoped_lock<WriterMutex> guard{ lock_ };
+                        for (const auto& [argType, prototype] : database_)
+                        {
+                            auto& signature = result.signatures.emplace_back(MetricsSnapshot::Signature{ argType });
+                            prototype->metrics.AddTo(signature);
+                            for (const auto& [key, runs] : prototype->selectors)
+                            {
+                                runs->metrics.AddTo(signature.groups.emplace_back(MetricsSnapshot::Group{ key }).execute);
+                            }
+                        }
+                    }
+                    result.writerWaits = lock_.Waits();
+                    result.linkerWaits = linkerWaits_.Load();
+                }
+                return result;
+            }
+
+            template <Streamable Stream>
+            void Output(Stream& stream) const
+            {
+                for (const auto& stats : Statistics())
+                {
+                    stream << "\n  " << ShowTupleArgs(stats.signature);
+                    for (const auto& [key, size] : stats.groups)
+                    {
+                        stream << "\n" << std::setw(6) << size << ": " << ShowTupleArgs(key);
+                    }
+                }
+                if constexpr (helpers::metrics)
+                {
+                    stream << "\n  metrics:" << Metrics();
+                }
+            }
+
+        };
+
+        size_t CallTypes() const
+        {
+            if (data_)
+            {
+                return data_->CallTypes();
+            }
+            return {};
+        }
+
+        size_t SubscriptionCount() const
+        {
+            if (data_)
+            {
+                return data_->SubscriptionCount();
+            }
+            return {};
+
+        }
+
+        /// @brief The coroutines suspended in Next(), which wait without subscribing
+        size_t WaiterCount() const
+        {
+            if (data_)
+            {
+                return data_->WaiterCount();
+            }
+            return {};
+        }
+
+        /// @brief The distinct SelectTypes, that is the combinations of condition types, subscribed to
+        size_t SelectorCount() const
+        {
+            if (data_)
+            {
+                return data_->SelectorCount();
+            }
+            return {};
+        }
+
+        /// @brief The selector groups which subscriptions are kept in, where several SelectTypes may share one
+        size_t GroupCount() const
+        {
+            if (data_)
+            {
+                return data_->GroupCount();
+            }
+            return {};
+        }
+
+        size_t AnchorCount() const
+        {
+            if (data_)
+            {
+                return data_->AnchorCount();
+            }
+            return {};
+        }
+
+        /** @brief The subscriptions of each call signature, which may be read while publishing goes on
+         *
+         * Like the counts above, this takes no lock, so it never holds up publishers
+         * or subscribers.
+         */
+        ::std::vector<SignatureStats> Statistics() const
+        {
+            if (data_)
+            {
+                return data_->Statistics();
+            }
+            return {};
+        }
+
+        /** @brief What publishing has found, how long it took, and how often locks were waited for
+         *
+         * Empty unless TBD_PUBSUB_METRICS is defined.  The counts are kept separately for
+         * each thread, and only added up here.
+         */
+        MetricsSnapshot Metrics() const
+        {
+            if (data_)
+            {
+                return data_->Metrics();
+            }
+            return {};
+        }
+
+        PubSub() = default;
+        explicit PubSub(RemoveEmptySets arg) : data_{ ::std::make_shared<Data>(arg) } {}
+        explicit PubSub(::std::ostream& debugStream) : data_{ ::std::make_shared<Data>(debugStream) } {}
+        explicit PubSub(const Async& options) { data_->StartExecutor(data_, options); }
+        /** @brief Allocate subscriptions from the given resource, which must be thread-safe
+         *
+         * The resource must outlive the PubSub and every anchor made from it.
+         */
+        explicit PubSub(::std::pmr::memory_resource& resource) : data_{ ::std::make_shared<Data>(resource) } {}
+
+        /** @brief A handle which publishes one call signature without looking it up on each call
+         *
+         * The prototype for the signature is resolved when the handle is made, and it
+         * remains valid while subscriptions for it come and go.
+         */
+        template<typename... Args>
+        class Publisher
+        {
+            using TupleType = helpers::ArgsToTuple<Args...>;
+
+            ::std::shared_ptr<Data> data_{};
+            const Prototype* prototype_{};
+
+        public:
+            explicit Publisher(::std::shared_ptr<Data> data) :
+                data_{ ::std::move(data) }, prototype_{ data_->Pin(::std::type_index{ typeid(TupleType) }) }
+            {
+            }
+            ~Publisher()
+            {
+                if (data_)
+                {
+                    data_->Unpin(prototype_);
+                }
+            }
+            Publisher(const Publisher& copy) :
+                data_{ copy.data_ }, prototype_{ data_ ? data_->Pin(::std::type_index{ typeid(TupleType) }) : nullptr }
+            {
+            }
+            Publisher& operator=(const Publisher& copy)
+            {
+                auto tmp{ copy };
+                ::std::swap(data_, tmp.data_);
+                ::std::swap(prototype_, tmp.prototype_);
+                return *this;
+            }
+            Publisher(Publisher&& donor) noexcept :
+                data_{ ::std::move(donor.data_) }, prototype_{ ::std::exchange(donor.prototype_, nullptr) }
+            {
+            }
+            Publisher& operator=(Publisher&& donor) noexcept
+            {
+                ::std::swap(data_, donor.data_);
+                ::std::swap(prototype_, donor.prototype_);
+                return *this;
+            }
+
+            void Publish(helpers::ArgToTuple_t<Args>... args) const
+            {
+                if (!data_->HasSubscribers(helpers::SignatureId<TupleType>()))
+                {
+                    return;
+                }
+                TupleType argTuple{ args... };
+                Epochs::Guard epoch{ data_->GetEpochs() };
+                Dispatch(*data_, data_->GetMatches(*prototype_, argTuple), argTuple);
+            }
+
+            void operator()(helpers::ArgToTuple_t<Args>... args) const { Publish(args...); }
+        };
+
+        /** @brief Lets a coroutine's owner cancel it safely while a match on another thread resumes it
+         *
+         * An awaiter resumes a coroutine whose promise derives from this while holding
+         * the lock, and not at all once it's cancelled.  The owner cancels before it
+         * destroys the coroutine, which waits for a resumption in progress to suspend.
+         */
+        struct Cancellation
+        {
+            ::std::mutex lock{};
+            bool cancelled{};
+
+            void Cancel()
+            {
+                ::std::scoped_lock guard{ lock };
+                cancelled = true;
+            }
+        };
+
+        template<typename Event, typename Conditions>
+        class Awaiter;
+
+        /** @brief Waits for the first event matching the conditions, without subscribing
+         *
+         * The awaiter lives in the coroutine's frame, and is put on the waiters for its
+         * call signature when the coroutine suspends.  The coroutine is resumed on the
+         * publishing thread, within the call which published the match, or at once if
+         * the match came before it had suspended.  Destroying a suspended coroutine
+         * takes the awaiter off the list, or waits for a publisher which has already
+         * taken it.  A coroutine whose promise isn't a Cancellation, unlike a Chain,
+         * must not be destroyed while a publish on another thread may be resuming it.
+         */
+        template<typename... Args, typename... Conds>
+        class Awaiter<::std::tuple<Args...>, ::std::tuple<Conds...>> : public Waiter
+        {
+        public:
+            using Value = ::std::tuple<::std::decay_t<Args>...>;
+
+        private:
+            using TupleType = helpers::ArgsToTuple<Args...>;
+            using SelectType = helpers::SelType<void (*)(Args...), Conds...>;
+
+            ::std::shared_ptr<Data> data_;
+            SelectType select_;
+            ::std::coroutine_handle<> waiting_{};
+            Cancellation* cancellation_{};
+            ::std::optional<Value> event_{};
+            ::std::atomic<bool> handoff_{}; ///< Set by the first of suspension and the match; the second resumes
+
+            bool Accepts(const void* args) const override { return select_ == *static_cast<const TupleType*>(args); }
+
+            void Fire(const void* args) override
+            {
+                event_.emplace(::std::make_from_tuple<Value>(*static_cast<const TupleType*>(args)));
+                auto& data = *data_;
+                if (!handoff_.exchange(true))
+                {
+                    // the thread which is suspending the coroutine continues it instead
+                    data.Fired(*this);
+                    return;
+                }
+                auto waiting = waiting_;
+                if (auto cancellation = cancellation_)
+                {
+                    // the owner can't destroy the coroutine while this is held
+                    ::std::unique_lock guard{ cancellation->lock };
+                    if (cancellation->cancelled)
+                    {
+                        guard.unlock();
+                        data.Fired(*this);
+                        return;
+                    }
+                    data.Fired(*this);
+                    waiting.resume();
+                }
+                else
+                {
+                    data.Fired(*this);
+                    waiting.resume();
+                }
+            }
+
+        public:
+            template<typename... Params>
+            explicit Awaiter(::std::shared_ptr<Data> data, Params&&... conditions) :
+                Waiter{ ::std::type_index{ typeid(TupleType) }, helpers::SignatureId<TupleType>() },
+                data_{ ::std::move(data) },
+                select_{ helpers::ExtendTuple<SelectType>(::std::forward<Params>(conditions)...) }
+            {
+            }
+            ~Awaiter()
+            {
+                if (waiting_)
+                {
+                    data_->Cancel(*this);
+                }
+            }
+
+            bool await_ready() const noexcept { return false; }
+            template<typename Promise>
+            bool await_suspend(::std::coroutine_handle<Promise> waiting)
+            {
+                waiting_ = waiting;
+                if constexpr (::std::is_base_of_v<Cancellation, Promise>)
+                {
+                    cancellation_ = &waiting.promise();
+                }
+                data_->Wait(*this);
+                // a match on another thread may have come before the wait was returned
+                return !handoff_.exchange(true);
+            }
+            Value await_resume() { return ::std::move(*event_); }
+        };
+
+        /** @brief A coroutine which waits on a chain of events, and is cancelled by destroying it
+         *
+         * It runs as soon as it's called, up to its first co_await, and the handle owns
+         * its frame from then on.  It may be destroyed on any thread, even while a match
+         * is resuming it, in which case destruction waits until it next suspends; but
+         * not from within the coroutine itself.  An exception which escapes the
+         * coroutine finishes it, and is kept for Rethrow() rather than thrown into
+         * whichever publish resumed it.
+         *
+         *     PubSub::Chain Watch(PubSub pubsub, pid_t pid)
+         *     {
+         *         auto [op, fd] = co_await pubsub.Next<Op, pid_t, int>(Op::FileOpen, pid, tbd::any);
+         *         co_await pubsub.Next<Op, pid_t, int>(Op::FileClose, pid, fd);
+         *     }
+         */
+        class Chain
+        {
+        public:
+            struct promise_type : Cancellation
+            {
+                ::std::exception_ptr exception{};
+
+                Chain get_return_object() { return Chain{ ::std::coroutine_handle<promise_type>::from_promise(*this) }; }
+                ::std::suspend_never initial_suspend() noexcept { return {}; }
+                ::std::suspend_always final_suspend() noexcept { return {}; }
+                void return_void() {}
+                void unhandled_exception() { exception = ::std::current_exception(); }
+            };
+
+        private:
+            ::std::coroutine_handle<promise_type> handle_{};
 
-            using ScopedLock = ::std::scoped_lock<::std::shared_mutex>;
+            explicit Chain(::std::coroutine_handle<promise_type> handle) : handle_{ handle } {}
 
         public:
-            Data() {}
-            explicit Data(::std::ostream& debugStream) : debugStream_{ &debugStream } {}
-            explicit Data(PubSub::RemoveEmptySets) : removeEmptySets_{true} {}
-            ScopedLock GetLock() { return ScopedLock{ lock_ }; }
+            Chain() = default;
+            ~Chain()
+            {
+                if (handle_)
+                {
+                    handle_.promise().Cancel();
+                    handle_.destroy();
+                }
+            }
+            Chain(Chain&& donor) noexcept : handle_{ ::std::exchange(donor.handle_, {}) } {}
+            Chain& operator=(Chain&& donor) noexcept
+            {
+                ::std::swap(handle_, donor.handle_);
+                return *this;
+            }
 
-            void AddElement(::std::shared_ptr<Linker>& linker, ::std::unique_ptr<ElementBase> base)
+            /// @brief Whether the coroutine has finished
+            bool Done() const { return !handle_ || handle_.done(); }
+
+            /// @brief Throw the exception which finished the coroutine, if one did
+            void Rethrow() const
             {
-                ScopedLock guard{ lock_ };
-                auto argType = base->ArgumentType();
-                auto& perPrototype = database_[base->ArgumentType()];
-                auto& selectorSet = perPrototype[base->SelectArgs()];
-                auto it = selectorSet.insert(::std::move(base));
-                Linker::Remember(linker, selectorSet, it);
-                if (debugStream_)
+                if (Done() && handle_ && handle_.promise().exception)
                 {
-                    *debugStream_ << "added : " << Demangle(argType) << "\n";
+                    ::std::rethrow_exception(handle_.promise().exception);
                 }
             }
+        };
 
-            template<typename Type>
-            MatchResults<::std::weak_ptr<ElementBase>> GetMatches(Type argTuple) const
+        /** @brief Finds sequences of events which agree on correlation variables
+         *
+         * Each step is one subscription, made when the sequence is compiled, and the
+         * runs part way through the sequence wait in a hash table for each step, keyed
+         * by the values of the variables which that step names and earlier steps bound.
+         * An event for a step looks its runs up, and moves them on to the next step's
+         * table, without subscribing or unsubscribing anything.  Every run which waits
+         * for an event moves on with it, and a run waits until it's finished or the
+         * anchor is destroyed.
+         *
+         *     constexpr tbd::Var<0> pid{};
+         *     constexpr tbd::Var<1> fd{};
+         *     auto sequence = pubsub.MakeSequence<pid_t, int>();
+         *     sequence.Then<Op, pid_t, const char*>(Op::ProcessStart, pid, tbd::any)
+         *         .Then<Op, pid_t, int>(Op::FileOpen, pid, fd)
+         *         .Then<Op, pid_t, int>(Op::FileClose, pid, fd);
+         *     auto anchor = sequence.Compile([](pid_t pid, int fd) {});
+         */
+        template<typename... Vars>
+        class Sequence
+        {
+            static_assert(sizeof...(Vars) <= 64U, "a variable mask has 64 bits");
+
+            using Bindings = ::std::tuple<Vars...>;
+
+            /// @brief The runs of a compiled sequence, waiting for each step
+            class Engine
             {
-                MatchResults<::std::weak_ptr<ElementBase>> winners{};
-                SharedGuard<::std::shared_mutex> guard{ lock_ };
-                if (auto perPrototypeIt = database_.find(::std::type_index{ typeid(decltype(argTuple)) });
-                    perPrototypeIt != database_.end())
+                /// @brief A partial match, and the event which last moved it on
+                struct Run
+                {
+                    Bindings bindings{};
+                    uint64_t event{};
+                };
+                using Table =
+                    ::std::unordered_map<Bindings, ::std::vector<Run>, helpers::SelectHash<Bindings>, helpers::TupleEqual>;
+
+                mutable ::std::mutex mutex_{};
+                ::std::vector<Table> waiting_{};  ///< The runs waiting for each step but the first
+                ::std::vector<uint64_t> keys_{};  ///< The variables by which each step finds its runs
+                ::std::vector<uint64_t> binds_{}; ///< The variables which each step binds
+                ::std::function<void(const Vars&...)> onMatch_{};
+                size_t runs_{};
+
+                static Bindings Project(const Bindings& run, uint64_t mask)
                 {
-                    const PerPrototype& perPrototype = perPrototypeIt->second;
-                    for (auto& [type, selectors] : perPrototype)
+                    Bindings key{};
+                    [&]<size_t... index>(::std::index_sequence<index...>)
                     {
-                        auto [first, last] = selectors.equal_range(argTuple);
-                        for (; first != last; ++first)
-                        {
-                            ElementBase* element = first->get();
-                            if (auto linker = element->GetLinker().lock())
-                            {
-                                winners.push_back(::std::shared_ptr<ElementBase>{ linker, element });
-                            }
-                        }
-                    }
+                        ((mask & (uint64_t{ 1U } << index) ? void(::std::get<index>(key) = ::std::get<index>(run))
+                                                            : void()),
+                         ...);
+                    }(::std::index_sequence_for<Vars...>{});
+                    return key;
                 }
-                else if (debugStream_)
+
+            public:
+                template<typename Func>
+                explicit Engine(const ::std::vector<uint64_t>& names, Func onMatch) :
+                    waiting_(names.size()), onMatch_{ ::std::move(onMatch) }
                 {
-                    *debugStream_ << "no subscriptions for " << Demangle(typeid(Type)) << "\n";
+                    uint64_t bound{};
+                    for (auto step : names)
+                    {
+                        keys_.push_back(step & bound);
+                        binds_.push_back(step & ~bound);
+                        bound |= step;
+                    }
                 }
-                return winners;
-            }
 
-            void ReleaseNodes(ElementBase& first)
-            {
-                bool removeEmpty{ false };
-                ::std::set<::std::unique_ptr<ElementBase>> nodes{};
+                /** @brief Move the runs waiting for a step on with an event
+                 *
+                 * A run which the same event has already moved on waits for the next one,
+                 * so one event can't take a run through several steps which it matches.
+                 *
+                 * @param bind sets the variables in a mask from the event's arguments
+                 */
+                template<typename Bind>
+                void Advance(size_t step, const Bind& bind)
                 {
-                    ScopedLock guard{ lock_ };
-                    auto it = first.next_;
-                    for (;;)
+                    const auto event = Dispatching::Current();
+                    ::std::vector<Bindings> finished{};
                     {
-                        auto& element = **it;
-                        auto& selectors = element.selectors_;
-                        auto next = element.next_;
-                        nodes.insert(selectors->extract(it));
-                        if (selectors->empty())
+                        ::std::lock_guard lock{ mutex_ };
+                        ::std::vector<Run> runs(step == 0U ? 1U : 0U);
+                        if (step != 0U)
                         {
-                            removeEmpty = true;
+                            Bindings key{};
+                            bind(key, keys_[step]);
+                            auto found = waiting_[step].find(key);
+                            if (found == waiting_[step].end())
+                            {
+                                return;
+                            }
+                            auto& waiting = found->second;
+                            auto moving = ::std::partition(
+                                waiting.begin(), waiting.end(), [event](const Run& run) { return run.event == event; });
+                            runs.assign(::std::make_move_iterator(moving), ::std::make_move_iterator(waiting.end()));
+                            waiting.erase(moving, waiting.end());
+                            if (waiting.empty())
+                            {
+                                waiting_[step].erase(found);
+                            }
+                            runs_ -= runs.size();
                         }
-                        if (&element == &first)
+                        for (auto& run : runs)
                         {
-                            break;
+                            bind(run.bindings, binds_[step]);
+                            if (step + 1U == waiting_.size())
+                            {
+                                finished.push_back(::std::move(run.bindings));
+                            }
+                            else
+                            {
+                                run.event = event;
+                                waiting_[step + 1U][Project(run.bindings, keys_[step + 1U])].push_back(::std::move(run));
+                                ++runs_;
+                            }
                         }
-                        it = next;
                     }
-                }
-                nodes.clear();
-
-                if (removeEmpty && removeEmptySets_)
-                {
-                    for (auto ppIt = database_.begin(); ppIt != database_.end();
-                         ppIt->second.empty() ? (ppIt = database_.erase(ppIt)) : ++ppIt)
+                    for (const auto& run : finished)
                     {
-                        for (auto it = ppIt->second.begin(); it != ppIt->second.end();
-                             it->second.empty() ? (it = ppIt->second.erase(it)) : ++it)
-                        {
-                        }
+                        ::std::apply(onMatch_, run);
                     }
                 }
-            }
 
-            size_t CallTypes() const {
-                ScopedLock guard{ lock_ };
-                return database_.size();
-            }
-            size_t SelectorCount() const
-            {
-                ScopedLock guard{ lock_ };
-                size_t result{};
-                for (const auto& p : database_)
+                size_t size() const
                 {
-                    result += p.second.size();
+                    ::std::lock_guard lock{ mutex_ };
+                    return runs_;
                 }
-                return result;
-            }
-            size_t SubscriptionCount() const
+            };
+
+            /// @brief A step's variables, and how to subscribe to it
+            struct Step
             {
-                ScopedLock guard{ lock_ };
-                size_t result{};
-                for (const auto& p : database_)
+                uint64_t names{};
+                ::std::function<void(Anchor&, const ::std::shared_ptr<Engine>&, size_t)> subscribe{};
+            };
+
+            ::std::shared_ptr<Data> data_;
+            ::std::vector<Step> steps_{};
+            ::std::shared_ptr<Engine> engine_{};
+
+            /// @brief Set the variables in a mask from the arguments which the conditions name them at
+            template<typename Conditions, typename ArgTuple>
+            static void Bind(Bindings& bindings, uint64_t mask, const ArgTuple& args)
+            {
+                [&]<size_t... position>(::std::index_sequence<position...>)
                 {
-                    for (const auto& s : p.second)
-                    {
-                        result += s.second.size();
-                    }
-                }
-                return result;
+                    (
+                        [&]
+                        {
+                            using Condition = ::std::tuple_element_t<position, Conditions>;
+                            if constexpr (helpers::IsVar<Condition>)
+                            {
+                                if (mask & helpers::VarBit<Condition>)
+                                {
+                                    ::std::get<Condition::value>(bindings) = ::std::get<position>(args);
+                                }
+                            }
+                        }(),
+                        ...);
+                }(::std::make_index_sequence<::std::tuple_size_v<Conditions>>{});
             }
-            size_t AnchorCount() const
+
+        public:
+            explicit Sequence(::std::shared_ptr<Data> data) : data_{ ::std::move(data) } {}
+
+            /** @brief Add a step, whose conditions are as for Subscribe(), or a tbd::Var<> to correlate on
+             *
+             * Each variable may be named once in a step.
+             */
+            template<typename... Args, typename... Conds>
+            Sequence& Then(Conds&&... conds)
             {
-                struct Comp
-                {
-                    bool operator()(const std::weak_ptr<Linker>& lhs, const std::weak_ptr<Linker>& rhs) const
-                    {
-                        return lhs.owner_before(rhs);
-                    }
-                };
-                std::set<std::weak_ptr<Linker>, Comp> linkers{};
-                ScopedLock guard{ lock_ };
-                for (const auto& i : database_)
-                {
-                    for (const auto& x : i.second)
+                using Conditions = ::std::tuple<::std::decay_t<Conds>...>;
+                steps_.push_back(Step{
+                    helpers::VarMask<Conditions>,
+                    [conditions = Conditions{ ::std::forward<Conds>(conds)... }](
+                        Anchor& anchor, const ::std::shared_ptr<Engine>& engine, size_t step)
                     {
-                        for (const auto& e : x.second)
-                        {
-                            linkers.insert(e->GetLinker());
-                        }
-                    }
-                }
-                return linkers.size();
+                        ::std::apply(
+                            [&](const auto&... condition)
+                            {
+                                anchor.Add(
+                                    [engine, step](Args... args)
+                                    {
+                                        engine->Advance(
+                                            step,
+                                            [&args...](Bindings& bindings, uint64_t mask)
+                                            { Bind<Conditions>(bindings, mask, ::std::forward_as_tuple(args...)); });
+                                    },
+                                    helpers::Unbound(condition)...);
+                            },
+                            conditions);
+                    } });
+                return *this;
             }
 
-            template <Streamable Stream>
-            void Output(Stream& stream) const
+            /** @brief Subscribe to the steps, calling onMatch with the variables of each finished run
+             *
+             * Runs are kept until the returned anchor is destroyed.
+             */
+            template<typename Func>
+            [[nodiscard]] Anchor Compile(Func onMatch)
             {
-                ScopedLock guard{ lock_ };
-                for (const auto& i : database_)
+                ::std::vector<uint64_t> names{};
+                for (const auto& step : steps_)
                 {
-                    stream << "\n  " << ShowTupleArgs(i.first);
-                    for (const auto& x : i.second)
-                    {
-                        stream << "\n" << std::setw(6) << x.second.size() << ": " << ShowTupleArgs(x.first);
-                    }
+                    names.push_back(step.names);
+                }
+                engine_ = ::std::make_shared<Engine>(names, ::std::move(onMatch));
+                Anchor anchor{ Linker::Make(data_, data_->GetMemory()) };
+                for (size_t step{}; step < steps_.size(); ++step)
+                {
+                    steps_[step].subscribe(anchor, engine_, step);
                 }
+                return anchor;
             }
 
+            /// @brief The runs part way through the compiled sequence
+            size_t PartialMatches() const { return engine_ ? engine_->size() : 0U; }
         };
 
-        size_t CallTypes() const
+        template<typename... Args>
+        void Publish(Args&&... args) const
         {
-            if (data_)
+            if (!data_->MayPublish(helpers::SignatureId<helpers::ArgsToTuple<Args...>>()))
             {
-                return data_->CallTypes();
+                return;
             }
-            return {};
+            helpers::ArgsToTuple<Args...> argTuple{ args... };
+            Epochs::Guard epoch{ data_->GetEpochs() };
+            Dispatch(*data_, data_->GetMatches(argTuple), argTuple);
         }
 
-        size_t SubscriptionCount() const
+        template<typename... Args>
+        void operator()(Args&&... args) const
         {
-            if (data_)
+            Publish(::std::forward<Args>(args)...);
+        }
+
+        /** @brief Publish without allocating memory, from threads where the heap must be avoided
+         *
+         * Matches go into a buffer which belongs to the calling thread, and which keeps
+         * its capacity, so once ReserveMatches() has made room, or an earlier publish has
+         * found as many matches, nothing is allocated.  The publisher never frees what
+         * has been unsubscribed, leaving that to other threads, and never writes debug
+         * output.  The callbacks themselves must also avoid allocating.
+         *
+         *     tbd::PubSub::ReserveMatches(100);
+         *     pubsub.PublishRealtime(Op::FileClose, pid, fd);
+         */
+        template<typename... Args>
+        void PublishRealtime(Args&&... args) const
+        {
+            using TupleType = helpers::ArgsToTuple<Args...>;
+            if (!data_->HasSubscribers(helpers::SignatureId<TupleType>()))
             {
-                return data_->SubscriptionCount();
+                return;
             }
-            return {};
-
+            TupleType argTuple{ args... };
+            Epochs::Guard epoch{ data_->GetEpochs(), false };
+            MatchBuffers::Lease buffer{};
+            MatchResults<ElementBase*> winners{ buffer.Get() };
+            data_->GetMatches(argTuple, winners);
+            Dispatch(*data_, ::std::move(winners), argTuple);
         }
 
-        size_t SelectorCount() const
+        /** @brief Make room for PublishRealtime() on the calling thread to find the given number of matches
+         *
+         * @param depth the number of levels of publishing from within callbacks to allow for
+         */
+        static void ReserveMatches(size_t matches, size_t depth = 1U) { MatchBuffers::Reserve(matches, depth); }
+
+        /** @brief Publish an event whose arguments are only made if something subscribes to them
+         *
+         * The producer returns the arguments as a tuple, and is not called when the
+         * call signature has no subscriptions.
+         *
+         *     pubsub.PublishLazy<Op, pid_t, std::string_view>(
+         *         [&] { return std::tuple{ Op::ProcessStart, pid, ResolvePath(pid) }; });
+         */
+        template<typename... Args, ::std::invocable Producer>
+        void PublishLazy(Producer&& producer) const
         {
-            if (data_)
+            using TupleType = helpers::ArgsToTuple<Args...>;
+            if (!data_->MayPublish(helpers::SignatureId<TupleType>()))
             {
-                return data_->SelectorCount();
+                return;
             }
-            return {};
+            // the produced tuple may own what the arguments refer to, so it must outlive them
+            auto&& produced = ::std::invoke(::std::forward<Producer>(producer));
+            const ::std::tuple<Args...>& values{ produced };
+            auto argTuple = helpers::AsArgTuple(values);
+            Epochs::Guard epoch{ data_->GetEpochs() };
+            Dispatch(*data_, data_->GetMatches(argTuple), argTuple);
         }
 
-        size_t AnchorCount() const
+        /** @brief Publish a batch of events which share a call signature
+         *
+         * The events are given as tuples, and are dispatched in order, exactly as if
+         * each had been passed to Publish(). Each run of up to 256 events is matched
+         * while taking the lock and finding the call signature once, unless a callback
+         * adds a subscription, in which case the remaining events are matched again.
+         *
+         *     std::vector<std::tuple<Op, pid_t, int>> events{ ... };
+         *     pubsub.PublishBatch(events);
+         */
+        template<::std::forward_iterator It>
+        void PublishBatch(It first, It last) const
         {
-            if (data_)
+            using Type = decltype(helpers::AsArgTuple(*first));
+            if (!data_->MayPublish(helpers::SignatureId<Type>()))
             {
-                return data_->AnchorCount();
+                return;
+            }
+            ::std::vector<MatchResults<ElementBase*>> matches{};
+            Epochs::Guard epoch{ data_->GetEpochs() };
+            while (first != last)
+            {
+                auto additions = data_->template GetMatches<Type>(first, ::std::ranges::next(first, 256, last), matches);
+                for (auto& winners : matches)
+                {
+                    auto argTuple = helpers::AsArgTuple(*first++);
+                    Dispatch(*data_, ::std::move(winners), argTuple);
+                    if (data_->Additions() != additions)
+                    {
+                        break;
+                    }
+                }
             }
-            return {};
         }
 
-        PubSub() = default;
-        explicit PubSub(RemoveEmptySets arg) : data_{ ::std::make_shared<Data>(arg) } {}
-        explicit PubSub(::std::ostream& debugStream) : data_{ ::std::make_shared<Data>(debugStream) } {}
+        template<::std::ranges::forward_range Events>
+        void PublishBatch(const Events& events) const
+        {
+            PublishBatch(::std::ranges::begin(events), ::std::ranges::end(events));
+        }
 
+        /** @brief Queue an event to be dispatched on a worker thread
+         *
+         * The arguments are copied, or moved, so the caller needn't keep them
+         * alive; pointers are copied as pointers though. The PubSub must have
+         * been constructed with Async options.
+         *
+         * @return false if the event was dropped because the queue was full
+         */
         template<typename... Args>
-        void Publish(Args&&... args) const
+        bool PublishAsync(Args&&... args) const
         {
-            helpers::ArgsToTuple<Args...> argTuple{ args... };
+            auto executor = data_->GetExecutor();
+            if (!executor)
+            {
+                throw ::std::runtime_error{ "PubSub was not constructed for asynchronous publishing" };
+            }
+            auto event = [values = ::std::tuple<::std::decay_t<Args>...>{ ::std::forward<Args>(args)... }](
+                             const Data& data)
+            {
+                auto argTuple = helpers::AsArgTuple(values);
+                Epochs::Guard epoch{ data.GetEpochs() };
+                Dispatch(data, data.GetMatches(argTuple), argTuple);
+            };
+            return executor->Push(Task{ ::std::move(event) });
+        }
 
-            // unlock
-            for (auto weak : data_->GetMatches(argTuple))
+        /** @brief Wait until the events queued so far by PublishAsync() have been dispatched
+         *
+         * Must not be called from a callback running on a worker thread.
+         */
+        void Flush() const
+        {
+            if (auto executor = data_->GetExecutor())
             {
-                if (auto winner = weak.lock())
-                {
-                    if (auto linker = winner->GetLinker().lock())
-                    {
-                        auto guard = linker->Protect(linker);
-                        winner->Execute(static_cast<const void*>(&argTuple));
-                    }
-                }
+                executor->Flush();
+            }
+        }
+
+        /** @brief The number of events PublishAsync() has dropped because the queue was full */
+        size_t DroppedEvents() const
+        {
+            if (auto executor = data_->GetExecutor())
+            {
+                return executor->Dropped();
             }
+            return {};
         }
 
+        /** @brief Check, without taking any lock, whether anything subscribes to a call signature
+         *
+         *     if (pubsub.HasSubscribers<Op, pid_t, const char*>())
+         */
         template<typename... Args>
-        void operator()(Args&&... args) const
+        bool HasSubscribers() const
         {
-            Publish(::std::forward<Args>(args)...);
+            return data_->HasSubscribers(helpers::SignatureId<helpers::ArgsToTuple<Args...>>());
         }
 
         template<typename Func, typename... Args>
         [[nodiscard]] Anchor Subscribe(Func func, Args&&... args)
         {
-            auto linker = ::std::make_shared<Linker>(data_);
+            auto linker = Linker::Make(data_, data_->GetMemory());
 
-            auto sel = ::std::make_unique<Select<Func, helpers::SelType<Func, Args...>>>(
-                ::std::move(func), ::std::forward<Args>(args)...);
+            ::std::unique_ptr<ElementBase> sel{ new (data_->GetMemory()->Resource())
+                                                    Select<Func, helpers::SelType<Func, Args...>>{
+                                                        ::std::move(func), ::std::forward<Args>(args)... } };
 
             data_->AddElement(linker, ::std::move(sel));
 
             return Anchor{ ::std::move(linker) };
         }
 
-        [[nodiscard]] Anchor MakeAnchor() { return Anchor{ ::std::make_shared<Linker>(data_) }; }
+        [[nodiscard]] Anchor MakeAnchor() { return Anchor{ Linker::Make(data_, data_->GetMemory()) }; }
+
+        /** @brief Make a builder for sequences of events which correlate on variables of the given types
+         *
+         *     auto sequence = pubsub.MakeSequence<pid_t>();
+         */
+        template<typename... Vars>
+        [[nodiscard]] Sequence<Vars...> MakeSequence() const
+        {
+            return Sequence<Vars...>{ data_ };
+        }
+
+        /** @brief Await the next event with the given call signature which matches the conditions
+         *
+         *     auto [op, pid, fd] = co_await pubsub.Next<Op, pid_t, int>(Op::FileOpen, pid, tbd::any);
+         */
+        template<typename... Args, typename... Conds>
+        [[nodiscard]] Awaiter<::std::tuple<Args...>, ::std::tuple<::std::decay_t<Conds>...>> Next(Conds&&... conds) const
+        {
+            return Awaiter<::std::tuple<Args...>, ::std::tuple<::std::decay_t<Conds>...>>{
+                data_, ::std::forward<Conds>(conds)...
+            };
+        }
+
+        /** @brief Make a handle which publishes events with the given call signature
+         *
+         *     auto publish = pubsub.MakePublisher<Op, pid_t, const char*>();
+         *     publish(Op::ProcessStart, 1234, "/bin/true");
+         */
+        template<typename... Args>
+        [[nodiscard]] Publisher<Args...> MakePublisher() const
+        {
+            return Publisher<Args...>{ data_ };
+        }
 
         /** @brief Return a container in which to drop anchors
          * @return an empty container for anchors
@@ -863,31 +4657,156 @@ namespace tbd
         }
 
     private:
+        /** @brief Call the matched subscriptions, and then fire the waiters which accept the event
+         *
+         * The caller must hold an Epochs::Guard for as long as it holds the matches,
+         * which keeps the elements and their linkers from being freed.
+         */
+        template<typename Type>
+        static void Dispatch(const Data& data, MatchResults<ElementBase*> matches, const Type& argTuple)
+        {
+            Dispatching event{};
+            for (ElementBase* winner : matches)
+            {
+                // a removed element's linker may have been freed, while the element waits for its runs to be rebuilt
+                if (winner->Removed())
+                {
+                    continue;
+                }
+                if (Linker::Guard guard{ *winner->GetLinker(), *winner })
+                {
+                    Stopwatch stopwatch{};
+                    winner->Execute(static_cast<const void*>(&argTuple));
+                    winner->GetRuns()->metrics.Record(stopwatch.Elapsed());
+                }
+            }
+            data.Wake(argTuple);
+        }
+
         ::std::shared_ptr<Data> data_{ ::std::make_shared<Data>() };
     };
 
-    inline bool PubSub::ElementBaseCompare::operator()(
-        const ::std::unique_ptr<ElementBase>& lhs,
-        const ::std::unique_ptr<ElementBase>& rhs) const
-    {
-        return lhs->Compare(rhs.get()) == ::std::partial_ordering::less;
-    }
-    template<typename... Args>
-    bool PubSub::ElementBaseCompare::operator()(
-        const ::std::unique_ptr<ElementBase>& lhs,
-        const ::std::tuple<Args...>& rhs) const
+    constexpr PubSub::RemoveEmptySets removeEmptySets{};
+
+    namespace helpers
     {
-        return lhs->Compare(static_cast<const void*>(&rhs)) == ::std::partial_ordering::less;
-    }
-    template<typename... Args>
-    bool PubSub::ElementBaseCompare::operator()(
-        const ::std::tuple<Args...>& lhs,
-        const ::std::unique_ptr<ElementBase>& rhs) const
+        template<typename Signature>
+        struct SignatureTraits;
+
+        template<typename... Args>
+        struct SignatureTraits<void(Args...)>
+        {
+            using TupleType = ArgsToTuple<Args...>;
+            using Publisher = PubSub::Publisher<Args...>;
+
+            static Publisher MakePublisher(const PubSub& pubsub) { return pubsub.MakePublisher<Args...>(); }
+        };
+
+        /// @brief The position of the signature taking the given argument tuple, or the number of signatures
+        template<typename TupleType, typename... Signatures>
+        constexpr size_t SignatureIndex()
+        {
+            constexpr ::std::array<bool, sizeof...(Signatures)> same{
+                ::std::is_same_v<TupleType, typename SignatureTraits<Signatures>::TupleType>...
+            };
+            return static_cast<size_t>(::std::find(same.begin(), same.end(), true) - same.begin());
+        }
+    } // namespace helpers
+
+    /** @brief A PubSub which only carries a fixed set of call signatures
+     *
+     *     tbd::StaticPubSub<void(Op, pid_t), void(Op, pid_t, const char*)> pubsub{};
+     *     auto anchor = pubsub.Subscribe([](Op, pid_t) {}, Op::ProcessEnd);
+     *     pubsub(Op::ProcessEnd, 1234);
+     *
+     * Each signature's prototype is resolved once, on construction, and publishing
+     * picks it at compile time rather than looking up the type of its arguments.
+     * Publishing or subscribing to any other signature doesn't compile.
+     */
+    template<typename... Signatures>
+    class StaticPubSub
     {
-        return rhs->Compare(static_cast<const void*>(&lhs)) == ::std::partial_ordering::greater;
-    }
+        PubSub pubsub_;
+        ::std::tuple<typename helpers::SignatureTraits<Signatures>::Publisher...> publishers_{
+            helpers::SignatureTraits<Signatures>::MakePublisher(pubsub_)...
+        };
 
-    constexpr PubSub::RemoveEmptySets removeEmptySets{};
+        template<typename TupleType>
+        static constexpr size_t IndexOf()
+        {
+            constexpr auto index = helpers::SignatureIndex<TupleType, Signatures...>();
+            static_assert(index < sizeof...(Signatures), "call signature is not one of this StaticPubSub's signatures");
+            return index;
+        }
+
+    public:
+        /** @brief An anchor which only takes subscriptions to the StaticPubSub's signatures */
+        class Anchor : public PubSub::Anchor
+        {
+        public:
+            Anchor() = default;
+            explicit Anchor(PubSub::Anchor anchor) : PubSub::Anchor{ ::std::move(anchor) } {}
+            Anchor& operator=(::std::nullptr_t)
+            {
+                auto tmp = ::std::move(*this);
+                return *this;
+            }
+
+            template<typename Func, typename... Args>
+            [[nodiscard]] Anchor Subscribe(Func func, Args&&... args)
+            {
+                Add(::std::move(func), ::std::forward<Args>(args)...);
+                return Anchor{ ::std::move(*this) };
+            }
+
+            template<typename Func, typename... Args>
+            Anchor& Add(Func func, Args&&... args)
+            {
+                static_cast<void>(IndexOf<helpers::GetTuple_t<Func>>());
+                PubSub::Anchor::Add(::std::move(func), ::std::forward<Args>(args)...);
+                return *this;
+            }
+        };
+
+        StaticPubSub() = default;
+        explicit StaticPubSub(PubSub pubsub) : pubsub_{ ::std::move(pubsub) } {}
+
+        template<typename... Args>
+        void Publish(Args&&... args) const
+        {
+            ::std::get<IndexOf<helpers::ArgsToTuple<Args...>>()>(publishers_).Publish(args...);
+        }
+
+        template<typename... Args>
+        void operator()(Args&&... args) const
+        {
+            Publish(::std::forward<Args>(args)...);
+        }
+
+        template<typename Func, typename... Args>
+        [[nodiscard]] Anchor Subscribe(Func func, Args&&... args)
+        {
+            return MakeAnchor().Subscribe(::std::move(func), ::std::forward<Args>(args)...);
+        }
+
+        [[nodiscard]] Anchor MakeAnchor() { return Anchor{ pubsub_.MakeAnchor() }; }
+
+        /** @brief The underlying PubSub, which is not restricted to these signatures */
+        const PubSub& GetPubSub() const { return pubsub_; }
+
+        size_t CallTypes() const { return pubsub_.CallTypes(); }
+        size_t SubscriptionCount() const { return pubsub_.SubscriptionCount(); }
+        size_t SelectorCount() const { return pubsub_.SelectorCount(); }
+        size_t GroupCount() const { return pubsub_.GroupCount(); }
+        size_t AnchorCount() const { return pubsub_.AnchorCount(); }
+        ::std::vector<PubSub::SignatureStats> Statistics() const { return pubsub_.Statistics(); }
+
+        template<Streamable Stream>
+        friend Stream& operator<<(Stream& stream, const StaticPubSub& p)
+        {
+            return stream << p.pubsub_;
+        }
+    };
 
     template<typename Type>
     class LE
@@ -896,6 +4815,7 @@ namespace tbd
 
     public:
         explicit LE(Type value) : value_{ ::std::move(value) } {}
+        const Type& Value() const { return value_; }
         ~LE() = default;
         LE() = default;
         LE(LE&&) = default;
@@ -916,7 +4836,7 @@ namespace tbd
     };
 
     template<typename Type>
-    LE(Type&&) -> LE<Type>;
+    LE(Type) -> LE<Type>;
 
     template<typename Type>
     class LT
@@ -925,6 +4845,7 @@ namespace tbd
 
     public:
         explicit LT(Type value) : value_{ ::std::move(value) } {}
+        const Type& Value() const { return value_; }
         ~LT() = default;
         LT() = default;
         LT(LT&&) = default;
@@ -945,7 +4866,7 @@ namespace tbd
     };
 
     template<typename Type>
-    LT(Type&&) -> LT<Type>;
+    LT(Type) -> LT<Type>;
 
     template<typename Type>
     class GE
@@ -954,6 +4875,7 @@ namespace tbd
 
     public:
         explicit GE(Type value) : value_{ ::std::move(value) } {}
+        const Type& Value() const { return value_; }
         GE() = default;
         ~GE() = default;
         GE(GE&&) = default;
@@ -973,7 +4895,7 @@ namespace tbd
         }
     };
     template<typename Type>
-    GE(Type&&) -> GE<Type>;
+    GE(Type) -> GE<Type>;
 
     template<typename Type>
     class GT
@@ -982,6 +4904,7 @@ namespace tbd
 
     public:
         explicit GT(Type value) : value_{ ::std::move(value) } {}
+        const Type& Value() const { return value_; }
         GT() = default;
         ~GT() = default;
         GT(GT&&) = default;
@@ -1000,7 +4923,7 @@ namespace tbd
         }
     };
     template<typename Type>
-    GT(Type&&) -> GT<Type>;
+    GT(Type) -> GT<Type>;
 
     template <class Type, Type mask>
     class BitSelect
@@ -1054,4 +4977,7 @@ namespace tbd
         explicit BitSelect(Type bits) : bits_{bits & mask} {}
         operator Type () const { return bits_; }
     };
+#if defined(TBD_PUBSUB_METRICS)
+    } // namespace instrumented
+#endif
 } // namespace tbd
\ No newline at end of file
@@ -0,0 +1,55 @@
+#include "allocations.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    thread_local size_t allocations{};
+}
+
+size_t test::ThreadAllocations()
+{
+    return allocations;
+}
+
+void* operator new(size_t size)
+{
+    ++allocations;
+    if (auto p = std::malloc(size ? size : 1U))
+    {
+        return p;
+    }
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    ++allocations;
+    auto align = static_cast<size_t>(alignment);
+    if (auto p = std::aligned_alloc(align, (size + align - 1U) / align * align))
+    {
+        return p;
+    }
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, size_t, std::align_val_t) noexcept
+{
+    std::free(p);
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstddef>
+
+namespace test
+{
+    /// @brief The number of times the calling thread has called the global operator new
+    size_t ThreadAllocations();
+} // namespace test
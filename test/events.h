@@ -0,0 +1,83 @@
+#pragma once
+
+#include <type_traits>
+
+// The process/file event model used by the example tests and the benchmarks.
+
+enum class Op
+{
+    ProcessStart, // pid, path
+    FileOpen,     // pid, fd, how, path
+    FileClose,    // pid, fd
+    ProcessEnd,   // pid
+    FileDelete,   // pid, path
+};
+
+enum class Suspicious
+{
+    Mark, // Sus, path - Mark path as suspicious
+    Start, // Sus, pid, path - Indicate that an executable started on a tainted executable
+};
+
+enum class How
+{
+    Read = 1,
+    Write = 2,
+    Exec = 4,
+};
+inline How& operator|=(How& lhs, How rhs)
+{
+    lhs =
+        static_cast<How>(static_cast<std::underlying_type_t<How>>(lhs) | static_cast<std::underlying_type_t<How>>(rhs));
+    return lhs;
+}
+inline How& operator&=(How& lhs, How rhs)
+{
+    lhs =
+        static_cast<How>(static_cast<std::underlying_type_t<How>>(lhs) & static_cast<std::underlying_type_t<How>>(rhs));
+    return lhs;
+}
+inline How& operator^=(How& lhs, How rhs)
+{
+    lhs =
+        static_cast<How>(static_cast<std::underlying_type_t<How>>(lhs) ^ static_cast<std::underlying_type_t<How>>(rhs));
+    return lhs;
+}
+inline How operator|(How lhs, How rhs)
+{
+    lhs |= rhs;
+    return lhs;
+}
+inline How operator&(How lhs, How rhs)
+{
+    lhs &= rhs;
+    return lhs;
+}
+inline How operator^(How lhs, How rhs)
+{
+    lhs ^= rhs;
+    return lhs;
+}
+// auto operator<=>(const How& lhs, const How& rhs) { return static_cast<unsigned int>(lhs) <=> static_cast<unsigned int>(rhs); }
+
+template<class Stream, typename = typename Stream::char_type>
+Stream& operator<<(Stream& stream, How h)
+{
+    const char* comma = "";
+    if ((h & How::Read) == How::Read)
+    {
+        stream << comma << "Read";
+        comma = "|";
+    }
+    if ((h & How::Write) == How::Write)
+    {
+        stream << comma << "Write";
+        comma = "|";
+    }
+    if ((h & How::Exec) == How::Exec)
+    {
+        stream << comma << "Exec";
+        comma = "|";
+    }
+    return stream;
+}
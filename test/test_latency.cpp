@@ -0,0 +1,243 @@
+#include "pubsub.h"
+#include "events.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    using namespace std::chrono_literals;
+    using Clock = std::chrono::steady_clock;
+    using pid_t = int;
+
+    constexpr size_t events = 100'000;
+    constexpr pid_t pids = 10'000;
+
+    /// @brief The microseconds in an environment variable, or the default if it isn't set
+    std::chrono::nanoseconds GetBudget(const char* envName, std::chrono::nanoseconds defaultBudget)
+    {
+        if (const char* budgetText = std::getenv(envName))
+        {
+            return std::chrono::microseconds(std::atol(budgetText));
+        }
+        return defaultBudget;
+    }
+
+    /// @brief The latencies to stay within, where zero isn't checked
+    struct Budget
+    {
+        std::chrono::nanoseconds p99{ GetBudget("PUBSUBLATENCYP99", 20ms) };
+        std::chrono::nanoseconds p999{ GetBudget("PUBSUBLATENCYP999", 0ns) };
+        std::chrono::nanoseconds max{ GetBudget("PUBSUBLATENCYMAX", 0ns) };
+    };
+
+    /// @brief The distribution of a set of latency samples
+    class Percentiles
+    {
+        std::vector<std::chrono::nanoseconds> sorted_;
+
+        template<typename Stream>
+            requires requires { typename Stream::char_type; }
+        friend Stream& operator<<(Stream& stream, const Percentiles& p)
+        {
+            auto us = [](std::chrono::nanoseconds ns) { return static_cast<double>(ns.count()) / 1000.0; };
+            stream << "p50 " << us(p.Percentile(50.0)) << "us, p99 " << us(p.Percentile(99.0)) << "us, p99.9 "
+                   << us(p.Percentile(99.9)) << "us, max " << us(p.Max()) << "us";
+            return stream;
+        }
+
+    public:
+        explicit Percentiles(std::vector<std::chrono::nanoseconds> samples) : sorted_{ std::move(samples) }
+        {
+            std::ranges::sort(sorted_);
+        }
+
+        std::chrono::nanoseconds Percentile(double percent) const
+        {
+            auto rank = static_cast<size_t>(percent * static_cast<double>(sorted_.size()) / 100.0);
+            return sorted_[std::min(rank, sorted_.size() - 1U)];
+        }
+        std::chrono::nanoseconds Max() const { return sorted_.back(); }
+
+        void Check(const char* name, const Budget& budget) const
+        {
+            std::cerr << name << ": " << *this << "\n";
+            EXPECT_LE(Percentile(99.0), budget.p99) << name << " p99 over budget";
+            if (budget.p999 != 0ns)
+            {
+                EXPECT_LE(Percentile(99.9), budget.p999) << name << " p99.9 over budget";
+            }
+            if (budget.max != 0ns)
+            {
+                EXPECT_LE(Max(), budget.max) << name << " max over budget";
+            }
+        }
+    };
+
+    enum class Mode
+    {
+        Sync,
+        Async,
+    };
+
+    enum class Interference
+    {
+        None,     ///< steady state
+        Churn,    ///< another thread subscribes and unsubscribes on the same call signature
+        Teardown, ///< another thread destroys anchors whose callbacks are in progress
+    };
+
+    /** @brief Publish FileClose events among 10k subscriptions, timing each publish and the entry into its callback
+     *
+     * Each event carries its sequence number and the time it was published, and matches one
+     * subscription, whose callback records how long after publishing it was entered.  This only
+     * runs when PUBSUBLATENCY is set, since a loaded machine can miss any budget.
+     */
+    void Measure(const char* name, Mode mode, Interference interference)
+    {
+        if (std::getenv("PUBSUBLATENCY") == nullptr)
+        {
+            GTEST_SKIP() << "timing depends on the machine, so set PUBSUBLATENCY=1 to measure it";
+        }
+
+        // a second worker, so that measured events needn't wait behind a slow callback
+        tbd::PubSub pubsub = mode == Mode::Async ? tbd::PubSub{ tbd::PubSub::Async{ .threads = 2U } } : tbd::PubSub{};
+
+        std::vector<std::chrono::nanoseconds> publishing(events);
+        std::vector<std::chrono::nanoseconds> delivery(events);
+        auto anchor = pubsub.MakeAnchor();
+        for (pid_t pid{}; pid < pids; ++pid)
+        {
+            anchor.Add(
+                [&delivery](Op, pid_t, size_t sequence, Clock::time_point published)
+                { delivery[sequence] = Clock::now() - published; },
+                Op::FileClose,
+                pid);
+        }
+
+        std::vector<std::jthread> threads{};
+        switch (interference)
+        {
+        case Interference::Churn:
+            threads.emplace_back(
+                [&pubsub](std::stop_token stop)
+                {
+                    for (pid_t pid{ pids }; !stop.stop_requested(); ++pid)
+                    {
+                        auto churn = pubsub.Subscribe([](Op, pid_t, size_t, Clock::time_point) {}, Op::FileClose, pid);
+                    }
+                });
+            break;
+        case Interference::Teardown:
+        {
+            // the callback is in progress when its anchor is destroyed, so the destruction waits for it
+            auto entered = std::make_shared<std::atomic<bool>>(false);
+            auto slow = [entered](Op, pid_t)
+            {
+                entered->store(true);
+                entered->notify_all();
+                std::this_thread::sleep_for(100us);
+            };
+            if (mode == Mode::Sync)
+            {
+                threads.emplace_back(
+                    [&pubsub](std::stop_token stop)
+                    {
+                        while (!stop.stop_requested())
+                        {
+                            pubsub.Publish(Op::ProcessEnd, pid_t{ -1 });
+                            std::this_thread::yield();
+                        }
+                    });
+            }
+            threads.emplace_back(
+                [&pubsub, mode, entered, slow](std::stop_token stop)
+                {
+                    while (!stop.stop_requested())
+                    {
+                        auto teardown = pubsub.Subscribe(slow, Op::ProcessEnd, pid_t{ -1 });
+                        if (mode == Mode::Async)
+                        {
+                            pubsub.PublishAsync(Op::ProcessEnd, pid_t{ -1 });
+                        }
+                        while (!entered->load() && !stop.stop_requested())
+                        {
+                            std::this_thread::yield();
+                        }
+                        teardown = {};
+                        entered->store(false);
+                    }
+                });
+            break;
+        }
+        default:
+            break;
+        }
+
+        for (size_t sequence{}; sequence < events; ++sequence)
+        {
+            const auto pid = static_cast<pid_t>(sequence * 7919U % pids);
+            const auto published = Clock::now();
+            if (mode == Mode::Sync)
+            {
+                pubsub.Publish(Op::FileClose, pid, sequence, published);
+            }
+            else
+            {
+                pubsub.PublishAsync(Op::FileClose, pid, sequence, published);
+            }
+            publishing[sequence] = Clock::now() - published;
+            if (mode == Mode::Async && sequence % 64U == 63U)
+            {
+                // keep the queue short, so that delivery measures dispatch rather than the backlog
+                pubsub.Flush();
+            }
+        }
+        pubsub.Flush();
+        threads.clear();
+
+        const Budget budget{};
+        Percentiles{ std::move(publishing) }.Check((std::string{ name } + " publish").c_str(), budget);
+        Percentiles{ std::move(delivery) }.Check((std::string{ name } + " publish to callback").c_str(), budget);
+    }
+} // namespace
+
+TEST(Latency, SteadyState)
+{
+    Measure("steady state", Mode::Sync, Interference::None);
+}
+
+TEST(Latency, SteadyStateAsync)
+{
+    Measure("async steady state", Mode::Async, Interference::None);
+}
+
+TEST(Latency, Churn)
+{
+    Measure("churn", Mode::Sync, Interference::Churn);
+}
+
+TEST(Latency, ChurnAsync)
+{
+    Measure("async churn", Mode::Async, Interference::Churn);
+}
+
+TEST(Latency, TeardownDuringCallback)
+{
+    Measure("teardown during callback", Mode::Sync, Interference::Teardown);
+}
+
+TEST(Latency, TeardownDuringCallbackAsync)
+{
+    Measure("async teardown during callback", Mode::Async, Interference::Teardown);
+}
@@ -0,0 +1,89 @@
+#define TBD_PUBSUB_METRICS
+#include "pubsub.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <latch>
+#include <sstream>
+#include <thread>
+#include <typeindex>
+
+namespace
+{
+    using namespace std::chrono_literals;
+    using IntTuple = tbd::helpers::ArgsToTuple<int>;
+
+    const tbd::PubSub::MetricsSnapshot::Signature* Find(const tbd::PubSub::MetricsSnapshot& m, std::type_index type)
+    {
+        for (const auto& signature : m.signatures)
+        {
+            if (signature.signature == type)
+            {
+                return &signature;
+            }
+        }
+        return nullptr;
+    }
+} // namespace
+
+TEST(Metrics, PublishCounts)
+{
+    tbd::PubSub pubsub{};
+    auto anchor = pubsub.Subscribe([](int) { std::this_thread::sleep_for(1ms); }, 42);
+    pubsub(42);
+    pubsub(43);
+    pubsub(43);
+    std::thread other{ [&pubsub] { pubsub(42); } };
+    other.join();
+
+    auto metrics = pubsub.Metrics();
+    auto signature = Find(metrics, typeid(IntTuple));
+    ASSERT_NE(nullptr, signature);
+    ASSERT_EQ(4U, signature->publishes) << "counts from every thread are added up";
+    ASSERT_EQ(2U, signature->matched);
+    ASSERT_EQ(2U, signature->unmatched);
+    ASSERT_EQ(4U, signature->match.Count());
+    ASSERT_EQ(1U, signature->groups.size());
+    ASSERT_EQ(2U, signature->groups[0].execute.Count());
+    ASSERT_LE(1'000'000U, signature->groups[0].execute.Percentile(0.5)) << "each callback sleeps for a millisecond";
+    ASSERT_LE(signature->groups[0].execute.Percentile(0.5), signature->groups[0].execute.Max());
+
+    std::ostringstream dump{};
+    dump << pubsub;
+    ASSERT_NE(std::string::npos, dump.str().find("2 matched, 2 unmatched")) << dump.str();
+}
+
+TEST(Metrics, LinkerWaits)
+{
+    // destroying an anchor while its callback runs on another thread waits, and that's counted
+    tbd::PubSub pubsub{};
+    std::latch started{ 1U };
+    auto anchor = pubsub.Subscribe(
+        [&started](int)
+        {
+            started.count_down();
+            std::this_thread::sleep_for(20ms);
+        });
+    std::thread publisher{ [&pubsub] { pubsub(1); } };
+    started.wait();
+    anchor = nullptr;
+    publisher.join();
+    ASSERT_EQ(1U, pubsub.Metrics().linkerWaits);
+}
+
+TEST(Metrics, Histogram)
+{
+    // buckets are within a quarter of a power of two, and every latency falls within its bucket
+    using Histogram = tbd::PubSub::Histogram;
+    for (uint64_t ns : { 0ULL, 3ULL, 4ULL, 7ULL, 8ULL, 1'000ULL, 1'234'567ULL, ~0ULL })
+    {
+        auto bucket = Histogram::Bucket(ns);
+        ASSERT_LT(bucket, Histogram::buckets);
+        ASSERT_LE(ns, Histogram::Highest(bucket)) << ns;
+        if (bucket > 0U)
+        {
+            ASSERT_LT(Histogram::Highest(bucket - 1U), ns) << ns;
+        }
+    }
+}
@@ -2,12 +2,16 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cstdlib>
 #include <chrono>
 #include <deque>
 #include <future>
 #include <iostream>
 #include <latch>
+#include <memory>
+#include <random>
 #include <string>
 #include <thread>
 #include <typeindex>
@@ -218,6 +222,33 @@ TEST(Perf, OneKSubscriptionMatch)
     std::cerr << "1k subscription match perf: " << m << "\n";
 }
 
+TEST(Perf, Publisher)
+{
+    enum class Op
+    {
+        FileOpen,
+        FileClose,
+    };
+    tbd::PubSub pubsub;
+    auto anchor = pubsub.Subscribe([](Op, int, int, const char*) {}, Op::FileOpen, 41)
+                      .Subscribe([](Op, int, int, const char*) {}, Op::FileOpen, 42)
+                      .Subscribe([](Op, int, int, const char*) {}, Op::FileClose, 43);
+
+    Perf m{};
+    while (m())
+    {
+        pubsub.Publish(Op::FileOpen, 42, 3, "/fileName");
+    }
+    std::cerr << "publish perf: " << m << "\n";
+
+    auto publish = pubsub.MakePublisher<Op, int, int, const char*>();
+    Perf p{};
+    while (p())
+    {
+        publish(Op::FileOpen, 42, 3, "/fileName");
+    }
+    std::cerr << "publisher perf: " << p << "\n";
+}
 class Thr
 {
     std::thread thread_{};
@@ -373,4 +404,440 @@ TEST(Perf, ThreadedSubscriptions)
     }
     std::chrono::high_resolution_clock::time_point end{ std::chrono::high_resolution_clock::now() };
     std::cerr << threadCount << " threads: " << "totalIterations: " << totalIterations << ": " << OperationsPerSecond(totalIterations, end - start) << std::endl;
-}
\ No newline at end of file
+}
+TEST(Perf, ThreadScaling)
+{
+    // Publish throughput for each number of publishing threads, up to one per core.  With publishers that share no
+    // cache lines the total should grow roughly linearly with the thread count.
+    tbd::PubSub pubsub{};
+    auto anchor = pubsub.Subscribe([](int) {}, 41).Subscribe([](int) {}, 42).Subscribe([](int) {}, 43);
+
+    for (auto threadCount = 1U; threadCount <= std::max(1U, std::thread::hardware_concurrency()); ++threadCount)
+    {
+        std::atomic_uint64_t totalIterations{};
+        std::atomic_bool done{ false };
+        auto func = [pubsub, &done, &totalIterations]
+        {
+            uint64_t iterations{};
+            while (!done)
+            {
+                ++iterations;
+                pubsub(42);
+            }
+            totalIterations += iterations;
+        };
+
+        std::chrono::high_resolution_clock::time_point start{};
+        {
+            std::vector<Thr> threads{};
+            threads.reserve(threadCount);
+
+            start = std::chrono::high_resolution_clock::now();
+            for (unsigned int i = 0; i < threadCount; ++i)
+            {
+                threads.emplace_back(func);
+            }
+            std::this_thread::sleep_for(perfDuration);
+            done = true;
+        }
+        std::chrono::high_resolution_clock::time_point end{ std::chrono::high_resolution_clock::now() };
+        std::cerr << threadCount << " threads: three subscriptions one match: "
+                  << OperationsPerSecond(totalIterations, end - start) << std::endl;
+    }
+}
+
+TEST(Perf, TimeWindowSubscriptions)
+{
+    // Each subscription expires itself once a timer event passes its deadline, as in PubSub.ExpireOnTime
+    constexpr auto subs = 100'000;
+    using Clock = std::chrono::steady_clock;
+    tbd::PubSub pubsub;
+    std::vector<tbd::PubSub::Anchor> anchors(subs);
+    auto start = Clock::now();
+    Measure s(subs);
+    for (int i{}; i < subs; ++i)
+    {
+        anchors[i] = pubsub.MakeAnchor();
+        anchors[i].Add([term = anchors[i].GetTerminator()](Clock::time_point) { term.Terminate(); },
+                       tbd::GE{ start + std::chrono::microseconds(i) });
+    }
+    s.Stop();
+    std::cerr << "100k time window subscription rate: " << s << "\n";
+
+    Perf m{};
+    while (m())
+    {
+        pubsub(start - 1s);
+    }
+    std::cerr << "100k time window no expiry perf: " << m << "\n";
+
+    Perf e{};
+    int tick{};
+    while (tick < subs && e())
+    {
+        pubsub(start + std::chrono::microseconds(tick++));
+    }
+    std::cerr << "100k time window expire one per tick perf: " << e << "\n";
+}
+
+TEST(Perf, BitSelectSubscriptions)
+{
+    // open events are filtered by pid and by the access mode and creation bits of their flags
+    constexpr unsigned int wrOnly = 01U;
+    constexpr unsigned int accMode = 03U;
+    constexpr unsigned int creat = 0100U;
+    constexpr int subs = 4'096;
+    tbd::PubSub pubsub;
+    auto anchor = pubsub.MakeAnchor();
+    for (int pid{}; pid < subs / 4; ++pid)
+    {
+        anchor.Add([](int, int, unsigned int) {}, pid, tbd::any, tbd::BitSelect<unsigned int, wrOnly>{ wrOnly });
+        anchor.Add([](int, int, unsigned int) {}, pid, tbd::any, tbd::BitSelect<unsigned int, accMode>{ accMode });
+        anchor.Add([](int, int, unsigned int) {}, pid, tbd::any, tbd::BitSelect<unsigned int, creat>{ creat });
+        anchor.Add([](int, int, unsigned int) {}, pid, tbd::any, tbd::BitSelect<unsigned int, creat | wrOnly>{ creat });
+    }
+
+    Perf m{};
+    int i{};
+    while (m())
+    {
+        ++i;
+        pubsub.Publish(i % (subs / 4), 3, (i & 1) ? creat | wrOnly : 0U);
+    }
+    std::cerr << "4k BitSelect subscriptions open event perf: " << m << "\n";
+}
+
+TEST(Perf, PublishAsync)
+{
+    // a slow subscriber costs the synchronous publisher its full duration,
+    // while the asynchronous publisher only pays for queueing the event
+    auto slow = [](int, int)
+    {
+        auto until = std::chrono::steady_clock::now() + 2us;
+        while (std::chrono::steady_clock::now() < until)
+        {
+        }
+    };
+    {
+        tbd::PubSub pubsub{};
+        auto anchor = pubsub.Subscribe(slow, 42);
+        Perf m{};
+        int i{};
+        while (m())
+        {
+            pubsub.Publish(42, ++i);
+        }
+        std::cerr << "slow subscriber synchronous publish perf: " << m << "\n";
+    }
+    {
+        tbd::PubSub pubsub{ tbd::PubSub::Async{ .capacity = 65'536, .overflow = tbd::PubSub::Overflow::DropNewest } };
+        auto anchor = pubsub.Subscribe(slow, 42);
+        Perf m{};
+        int i{};
+        while (m())
+        {
+            pubsub.PublishAsync(42, ++i);
+        }
+        pubsub.Flush();
+        std::cerr << "slow subscriber asynchronous publish perf: " << m << ", dropped " << pubsub.DroppedEvents()
+                  << " of " << i << "\n";
+    }
+
+    // end-to-end, from the first event queued to the last one dispatched
+    tbd::PubSub pubsub{ tbd::PubSub::Async{ .threads = 2 } };
+    std::atomic<size_t> calls{};
+    auto anchor = pubsub.Subscribe([&calls](int, int) { calls.fetch_add(1U, std::memory_order_relaxed); }, 42);
+    auto start = std::chrono::high_resolution_clock::now();
+    Perf p{};
+    size_t published{};
+    while (p())
+    {
+        ++published;
+        pubsub.PublishAsync(42, 3);
+    }
+    pubsub.Flush();
+    OperationsPerSecond throughput{ published, std::chrono::high_resolution_clock::now() - start };
+    ASSERT_EQ(published, calls.load());
+    std::cerr << "asynchronous publish perf: " << p << ", end-to-end: " << throughput << "\n";
+}
+
+TEST(Perf, PublishBatch)
+{
+    tbd::PubSub pubsub;
+    auto anchor = pubsub.Subscribe([](int, int, int) {}, 1, 41)
+                      .Subscribe([](int, int, int) {}, 1, 42)
+                      .Subscribe([](int, int, int) {}, 2, 43);
+
+    std::vector<std::tuple<int, int, int>> events{};
+    for (int i{}; i < 4'096; ++i)
+    {
+        events.emplace_back(1 + (i & 1), 40 + (i % 4), i);
+    }
+
+    Perf m{};
+    size_t i{};
+    while (m())
+    {
+        auto& [a, b, c] = events[i++ % events.size()];
+        pubsub.Publish(a, b, c);
+    }
+    std::cerr << "single publish perf: " << m << "\n";
+
+    for (size_t batchSize : { 16U, 256U, 4'096U })
+    {
+        size_t published{};
+        auto start = std::chrono::high_resolution_clock::now();
+        auto end = start + perfDuration;
+        auto now = start;
+        for (; now < end; now = std::chrono::high_resolution_clock::now())
+        {
+            auto first = events.begin() + static_cast<std::ptrdiff_t>(published % events.size());
+            pubsub.PublishBatch(first, first + static_cast<std::ptrdiff_t>(batchSize));
+            published += batchSize;
+        }
+        std::cerr << "batch of " << batchSize << " publish perf: " << OperationsPerSecond(published, now - start)
+                  << "\n";
+    }
+}
+
+TEST(Perf, StaticPubSub)
+{
+    enum class Op
+    {
+        ProcessStart,
+        FileOpen,
+        FileClose,
+        ProcessEnd,
+    };
+    auto subscribe = [](auto& pubsub)
+    {
+        auto anchor = pubsub.MakeAnchor();
+        for (int pid{}; pid < 64; ++pid)
+        {
+            anchor.Add([](Op, int, const char*) {}, Op::ProcessStart, pid);
+            anchor.Add([](Op, int, int, unsigned int, const char*) {}, Op::FileOpen, pid);
+            anchor.Add([](Op, int, int) {}, Op::FileClose, pid);
+            anchor.Add([](Op, int) {}, Op::ProcessEnd, pid);
+        }
+        return anchor;
+    };
+    auto publish = [](const auto& pubsub, const char* label)
+    {
+        Perf m{};
+        int i{};
+        while (m())
+        {
+            auto pid = ++i % 128;
+            pubsub(Op::ProcessStart, pid, "/procName");
+            pubsub(Op::FileOpen, pid, 3, 01U, "/fileName");
+            pubsub(Op::FileClose, pid, 3);
+            pubsub(Op::ProcessEnd, pid);
+        }
+        std::cerr << label << " process lifecycle perf: " << m << "\n";
+    };
+
+    tbd::PubSub dynamic{};
+    auto dynamicAnchor = subscribe(dynamic);
+    publish(dynamic, "PubSub");
+
+    tbd::StaticPubSub<void(Op, int, const char*), void(Op, int, int, unsigned int, const char*), void(Op, int, int), void(Op, int)>
+        fixed{};
+    auto fixedAnchor = subscribe(fixed);
+    publish(fixed, "StaticPubSub");
+}
+
+TEST(Perf, NoSubscriberPublish)
+{
+    // the clock is too slow to read for every publish, so time a fixed count
+    constexpr size_t count = 10'000'000U;
+    tbd::PubSub pubsub;
+    auto anchor = pubsub.Subscribe([](int) {});
+    Measure m{ count };
+    for (size_t i{}; i < count; ++i)
+    {
+        pubsub.Publish(static_cast<unsigned int>(i), "unsubscribed");
+    }
+    m.Stop();
+    std::cerr << "no subscriber publish perf: " << m << "\n";
+}
+
+TEST(Perf, PublishLazy)
+{
+    enum class Op
+    {
+        ProcessStart,
+    };
+    auto resolve = [](int pid) { return "/proc/" + std::to_string(pid) + "/exe"; };
+    tbd::PubSub pubsub;
+
+    Perf eager{};
+    int pid{};
+    while (eager())
+    {
+        ++pid;
+        pubsub.Publish(Op::ProcessStart, pid, resolve(pid));
+    }
+    std::cerr << "no subscriber eager publish perf: " << eager << "\n";
+
+    Perf lazy{};
+    while (lazy())
+    {
+        ++pid;
+        pubsub.PublishLazy<Op, int, std::string>([&] { return std::tuple{ Op::ProcessStart, pid, resolve(pid) }; });
+    }
+    std::cerr << "no subscriber lazy publish perf: " << lazy << "\n";
+
+    auto anchor = pubsub.Subscribe([](Op, int, const std::string&) {}, Op::ProcessStart, 1);
+    Perf subscribed{};
+    while (subscribed())
+    {
+        ++pid;
+        pubsub.PublishLazy<Op, int, std::string>([&] { return std::tuple{ Op::ProcessStart, pid, resolve(pid) }; });
+    }
+    std::cerr << "subscribed lazy publish perf: " << subscribed << "\n";
+}
+
+namespace
+{
+    enum class FileOp
+    {
+        Open,
+        Close,
+        Delete,
+    };
+    inline auto fileRuleCallback = [](FileOp, int, int, unsigned int, unsigned int) {};
+
+    /// @brief Rules of 3 to 5 scalar conditions, with two ranges so that none can be hashed
+    void ColumnarRules(int conditions, const char* label)
+    {
+        constexpr int rules = 10'000;
+        constexpr unsigned int creat = 0100U;
+        std::mt19937 random{ 42U };
+        std::uniform_int_distribution<int> ops{ 0, 2 };
+        std::uniform_int_distribution<int> pids{ 0, 32'768 };
+        std::uniform_int_distribution<int> fds{ 0, 1'024 };
+        std::uniform_int_distribution<unsigned int> uids{ 0U, 65'535U };
+
+        tbd::PubSub pubsub;
+        auto anchor = pubsub.MakeAnchor();
+        for (int rule{}; rule < rules; ++rule)
+        {
+            auto op = static_cast<FileOp>(ops(random));
+            auto pid = tbd::GE{ pids(random) };
+            auto fd = tbd::LT{ fds(random) };
+            auto flags = tbd::BitSelect<unsigned int, creat>{ (rule & 1) ? creat : 0U };
+            auto uid = tbd::LE{ uids(random) };
+            switch (conditions)
+            {
+            case 3:
+                anchor.Add(fileRuleCallback, op, pid, fd);
+                break;
+            case 4:
+                anchor.Add(fileRuleCallback, op, pid, fd, flags);
+                break;
+            default:
+                anchor.Add(fileRuleCallback, op, pid, fd, flags, uid);
+                break;
+            }
+        }
+
+        Perf m{};
+        while (m())
+        {
+            pubsub.Publish(
+                static_cast<FileOp>(ops(random)), pids(random), fds(random), uids(random) & creat, uids(random));
+        }
+        std::cerr << label << " perf: " << m << "\n";
+    }
+} // namespace
+
+TEST(Perf, ColumnarSubscriptions)
+{
+    ColumnarRules(3, "10k rules of 3 scalar conditions");
+    ColumnarRules(4, "10k rules of 4 scalar conditions");
+    ColumnarRules(5, "10k rules of 5 scalar conditions");
+}
+
+namespace
+{
+    /// @brief The event vocabulary of test_example.cpp, with every event carrying every argument
+    enum class ExampleOp
+    {
+        ProcessStart,
+        FileOpen,
+        FileClose,
+        ProcessEnd,
+        FileDelete,
+    };
+    enum class ExampleHow
+    {
+        Read = 1,
+        Write = 2,
+        Exec = 4,
+    };
+} // namespace
+
+TEST(Perf, DiscriminationNetwork)
+{
+    // 50k rules over eight patterns of exact conditions and tbd::any, including leading wildcards
+    constexpr int rules = 50'000;
+    constexpr int pids = 20'000;
+    constexpr int fds = 64;
+    std::vector<std::string> paths{};
+    for (int i{}; i < 1'000; ++i)
+    {
+        paths.push_back("/usr/lib/file" + std::to_string(i));
+    }
+    const std::array<ExampleHow, 3> hows{ ExampleHow::Read, ExampleHow::Write, ExampleHow::Exec };
+    std::mt19937 random{ 42U };
+    auto pick = [&random](auto limit) { return static_cast<int>(random() % static_cast<unsigned int>(limit)); };
+    auto op = [&pick] { return static_cast<ExampleOp>(pick(5)); };
+
+    size_t matches{};
+    auto callback = [&matches](ExampleOp, int, int, ExampleHow, std::string_view) { ++matches; };
+    tbd::PubSub pubsub;
+    auto anchor = pubsub.MakeAnchor();
+    for (int rule{}; rule < rules; ++rule)
+    {
+        std::string_view path{ paths[pick(paths.size())] };
+        auto how = hows[pick(hows.size())];
+        switch (rule % 8)
+        {
+        case 0:
+            anchor.Add(callback, op(), pick(pids));
+            break;
+        case 1:
+            anchor.Add(callback, op(), pick(pids), pick(fds));
+            break;
+        case 2:
+            anchor.Add(callback, op(), tbd::any, tbd::any, how);
+            break;
+        case 3:
+            anchor.Add(callback, tbd::any, pick(pids), tbd::any, ExampleHow::Write);
+            break;
+        case 4:
+            anchor.Add(callback, op(), tbd::any, tbd::any, tbd::any, path);
+            break;
+        case 5:
+            anchor.Add(callback, tbd::any, tbd::any, tbd::any, tbd::any, path);
+            break;
+        case 6:
+            anchor.Add(callback, op(), pick(pids), tbd::any, how, path);
+            break;
+        default:
+            anchor.Add(callback, tbd::any, pick(pids));
+            break;
+        }
+    }
+
+    Perf m{};
+    size_t events{};
+    while (m())
+    {
+        ++events;
+        pubsub.Publish(op(), pick(pids), pick(fds), hows[pick(hows.size())], std::string_view{ paths[pick(paths.size())] });
+    }
+    std::cerr << "50k example rules, " << pubsub.GroupCount() << " selector groups, "
+              << static_cast<double>(matches) / static_cast<double>(events) << " matches per event, perf: " << m << "\n";
+}
+
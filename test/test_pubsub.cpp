@@ -1,16 +1,27 @@
 #include "pubsub.h"
+#include "allocations.h"
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <array>
 #include <chrono>
 #include <deque>
 #include <future>
 #include <iostream>
 #include <latch>
+#include <map>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <span>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <typeindex>
+#include <variant>
 #include <vector>
 
 namespace
@@ -129,6 +140,7 @@ TEST(PubSub, BasicTest)
 
     ASSERT_EQ(2, pubsub.CallTypes());
     ASSERT_EQ(3, pubsub.SelectorCount());
+    ASSERT_EQ(2, pubsub.GroupCount()) << "exact conditions of one call type share a discrimination network";
     ASSERT_EQ(5, pubsub.SubscriptionCount());
     ASSERT_EQ(5, pubsub.AnchorCount());
 
@@ -422,4 +434,1182 @@ TEST(PubSub, RemoveEmptySets)
 
     // There's currently no way to check that all elements in the database have
     // been removed, though we'll see it with coverage.
-}
\ No newline at end of file
+}
+TEST(PubSub, Publisher)
+{
+    tbd::PubSub pubsub{ tbd::removeEmptySets };
+    auto publish = pubsub.MakePublisher<int, const char*>();
+
+    std::vector<std::string> results{};
+    publish(42, "nobody listening");
+    ASSERT_EQ(0, pubsub.CallTypes());
+
+    auto anchor = pubsub.Subscribe(
+        [&results](int a, const char* text) { results.emplace_back(std::to_string(a) + "," + text); }, 42);
+    publish(41, "no match");
+    publish(42, "first");
+    pubsub.Publish(42, "second");
+
+    anchor = nullptr; // empty sets are removed, but the prototype is retained for the publisher
+    publish(42, "unsubscribed");
+
+    auto copy = publish;
+    anchor = pubsub.Subscribe(
+        [&results](int a, const char* text) { results.emplace_back(std::to_string(a) + ":" + text); }, 42);
+    copy(42, "third");
+    publish(42, "fourth");
+
+    std::vector<std::string> expected{ "42,first", "42,second", "42:third", "42:fourth" };
+    ASSERT_EQ(expected, results);
+}
+
+TEST(PubSub, TerminateWaitsForOtherCallbacks)
+{
+    // A callback which destroys its own anchor does not wait for itself, but
+    // it does wait for the same anchor's callbacks on other threads.
+    std::latch started{ 1U };
+    std::latch release{ 1U };
+    tbd::PubSub pubsub{};
+    std::promise<void> p{};
+    auto f = p.get_future();
+    unsigned int calls{};
+
+    auto anchor = pubsub.MakeAnchor();
+    anchor.Add(
+        [&started, &release](int)
+        {
+            started.count_down();
+            release.wait();
+        },
+        42);
+    anchor.Add(
+        [term = anchor.GetTerminator(), &p, &calls](int)
+        {
+            ++calls;
+            term.Terminate();
+            p.set_value();
+        },
+        43);
+
+    std::thread thr1{ [&pubsub] { pubsub.Publish(42); } };
+    started.wait();
+    std::thread thr2{ [&pubsub] { pubsub.Publish(43); } };
+
+    ASSERT_EQ(std::future_status::timeout, f.wait_for(shortDelay));
+    release.count_down();
+    ASSERT_EQ(std::future_status::ready, f.wait_for(1s));
+    thr1.join();
+    thr2.join();
+
+    pubsub.Publish(43);
+    ASSERT_EQ(1U, calls);
+    ASSERT_FALSE(anchor);
+}
+
+TEST(PubSub, ReleaseWhilePublishing)
+{
+    // Subscriptions are released as soon as their anchor is destroyed, unless
+    // a publisher might still be using them, in which case they are released
+    // once it has finished.
+    tbd::PubSub pubsub{};
+    auto token = std::make_shared<int>(42);
+    auto anchor = pubsub.Subscribe([token](int) {});
+    ASSERT_EQ(2, token.use_count());
+    anchor = nullptr;
+    ASSERT_EQ(1, token.use_count());
+
+    long inCallback{};
+    anchor = pubsub.Subscribe(
+        [&anchor, &inCallback, token](int)
+        {
+            anchor = nullptr;
+            inCallback = token.use_count();
+        });
+    pubsub(42);
+    ASSERT_EQ(2, inCallback) << "the callback is still running, so it must not have been destroyed";
+    ASSERT_EQ(1, token.use_count());
+}
+
+TEST(PubSub, RemoveFromRuns)
+{
+    // removed subscriptions stay in their runs until enough are removed, but are
+    // never called, and their callbacks are released at once
+    tbd::PubSub pubsub{};
+    auto token = std::make_shared<int>(42);
+    std::vector<int> calls(100);
+    std::vector<tbd::PubSub::Anchor> anchors{};
+    for (int i{}; i < 100; ++i)
+    {
+        auto call = [&calls, i, token](int) { ++calls[static_cast<size_t>(i)]; };
+        anchors.push_back(i % 2 ? pubsub.Subscribe(call, 7) : pubsub.Subscribe(call, tbd::GE{ i }));
+    }
+    for (size_t i{}; i < 100U; i += 3U)
+    {
+        anchors[i] = nullptr;
+    }
+    ASSERT_EQ(1 + 66, token.use_count());
+    pubsub(7);
+    for (size_t i{}; i < 100U; ++i)
+    {
+        ASSERT_EQ(i % 3U && (i % 2U || i <= 7U) ? 1 : 0, calls[i]) << i;
+    }
+
+    anchors.resize(1U);
+    anchors.push_back(pubsub.Subscribe([&calls](int) { ++calls[0]; }, 7));
+    ASSERT_EQ(1, token.use_count());
+    pubsub(7);
+    ASSERT_EQ(1, calls[0]);
+    ASSERT_EQ(1, pubsub.SubscriptionCount());
+}
+
+TEST(PubSub, PublishWhileChurning)
+{
+    // publishers see a whole snapshot, so a subscription which outlives the churn is called for every event
+    tbd::PubSub pubsub{};
+    std::atomic<int> calls{};
+    auto anchor = pubsub.Subscribe([&calls](int) { ++calls; }, tbd::any);
+    constexpr int events = 10'000;
+    std::atomic<bool> done{};
+    std::jthread churn{ [&pubsub, &done]
+                        {
+                            for (int i{}; !done; ++i)
+                            {
+                                auto churned = pubsub.Subscribe([](int) {}, i % 64).Subscribe([](int) {}, tbd::GE{ i });
+                            }
+                        } };
+    {
+        std::vector<std::jthread> publishers{};
+        for (int t{}; t < 2; ++t)
+        {
+            publishers.emplace_back(
+                [&pubsub]
+                {
+                    for (int i{}; i < events; ++i)
+                    {
+                        pubsub(i % 64);
+                    }
+                });
+        }
+    }
+    done = true;
+    ASSERT_EQ(2 * events, calls);
+}
+
+TEST(PubSub, HashedSelectors)
+{
+    // exact conditions of the same type as the argument are found by hashing
+    enum class Colour
+    {
+        Red,
+        Green,
+    };
+    tbd::PubSub pubsub{};
+    std::vector<std::string> results{};
+    auto anchor =
+        pubsub
+            .Subscribe(
+                [&results](Colour, const std::string& text) { results.emplace_back("red:" + text); }, Colour::Red)
+            .Subscribe(
+                [&results](Colour, const std::string& text) { results.emplace_back("apple:" + text); },
+                tbd::any,
+                std::string{ "apple" })
+            .Subscribe(
+                [&results](Colour, const std::string& text) { results.emplace_back("green apple:" + text); },
+                Colour::Green,
+                std::string{ "apple" });
+    auto second = pubsub.Subscribe(
+        [&results](Colour, const std::string& text) { results.emplace_back("second red:" + text); }, Colour::Red);
+
+    pubsub(Colour::Red, std::string{ "apple" });
+    std::sort(results.begin(), results.end());
+    std::vector<std::string> expected{ "apple:apple", "red:apple", "second red:apple" };
+    ASSERT_EQ(expected, results);
+    results.clear();
+
+    pubsub(Colour::Green, std::string{ "apple" });
+    std::sort(results.begin(), results.end());
+    expected = { "apple:apple", "green apple:apple" };
+    ASSERT_EQ(expected, results);
+    results.clear();
+
+    anchor = nullptr;
+    pubsub(Colour::Red, std::string{ "pear" });
+    expected = { "second red:pear" };
+    ASSERT_EQ(expected, results);
+    ASSERT_EQ(1, pubsub.SubscriptionCount());
+}
+
+TEST(PubSub, RangeSelectors)
+{
+    using Tuple = tbd::helpers::ArgsToTuple<int, long>;
+    static_assert(std::is_base_of_v<
+                  tbd::PubSub::IntervalGroup<Tuple, std::tuple<const int, const tbd::GE<long>>>,
+                  tbd::PubSub::GroupFor<Tuple, std::tuple<const int, const tbd::GE<long>>>>);
+    static_assert(std::is_base_of_v<
+                  tbd::PubSub::ColumnarGroup<Tuple>,
+                  tbd::PubSub::GroupFor<Tuple, std::tuple<const tbd::LT<int>, const tbd::GE<long>>>>);
+
+    tbd::PubSub pubsub{};
+    std::multiset<std::string> results{};
+    auto anchor = pubsub.MakeAnchor();
+    for (long bound = 10; bound <= 12; ++bound)
+    {
+        auto b = std::to_string(bound);
+        anchor.Add([&results, b](int, long) { results.insert("GE" + b); }, 1, tbd::GE{ bound });
+        anchor.Add([&results, b](int, long) { results.insert("GT" + b); }, 1, tbd::GT{ bound });
+        anchor.Add([&results, b](int, long) { results.insert("LE" + b); }, 1, tbd::LE{ bound });
+        anchor.Add([&results, b](int, long) { results.insert("LT" + b); }, 1, tbd::LT{ bound });
+        anchor.Add([&results, b](int, long) { results.insert("other" + b); }, 2, tbd::GE{ bound });
+    }
+
+    pubsub(1, 11L);
+    std::multiset<std::string> expected{ "GE10", "GE11", "GT10", "LE11", "LE12", "LT12" };
+    ASSERT_EQ(expected, results);
+    results.clear();
+
+    pubsub(2, 10L);
+    expected = { "other10" };
+    ASSERT_EQ(expected, results);
+}
+
+TEST(PubSub, BitSelectMasks)
+{
+    using Tuple = tbd::helpers::ArgsToTuple<int, unsigned int>;
+    using Select = std::tuple<const int, const tbd::BitSelect<unsigned int, 03U>>;
+    static_assert(std::is_base_of_v<tbd::PubSub::HashedGroup<Tuple, Select>, tbd::PubSub::GroupFor<Tuple, Select>>);
+
+    tbd::PubSub pubsub{};
+    std::multiset<std::string> results{};
+    auto anchor = pubsub.MakeAnchor();
+    anchor.Add([&results](int, unsigned int) { results.insert("write"); }, 1, tbd::BitSelect<unsigned int, 03U>{ 01U });
+    anchor.Add([&results](int, unsigned int) { results.insert("rdwr"); }, 1, tbd::BitSelect<unsigned int, 03U>{ 02U });
+    anchor.Add([&results](int, unsigned int) { results.insert("creat"); }, 1, tbd::BitSelect<unsigned int, 0100U>{ 0100U });
+    anchor.Add([&results](int, unsigned int) { results.insert("other"); }, 2, tbd::BitSelect<unsigned int, 0100U>{ 0100U });
+
+    pubsub(1, 0101U);
+    std::multiset<std::string> expected{ "creat", "write" };
+    ASSERT_EQ(expected, results);
+    results.clear();
+
+    pubsub(1, 0002U);
+    expected = { "rdwr" };
+    ASSERT_EQ(expected, results);
+    results.clear();
+
+    pubsub(1, 0000U);
+    ASSERT_TRUE(results.empty());
+}
+
+TEST(PubSub, PublishAsync)
+{
+    tbd::PubSub pubsub{ tbd::PubSub::Async{ .threads = 2 } };
+    std::mutex lock{};
+    std::multiset<std::string> results{};
+    auto anchor = pubsub.Subscribe(
+        [&lock, &results](int a, const std::string& text)
+        {
+            std::scoped_lock guard{ lock };
+            results.insert(std::to_string(a) + "," + text);
+        },
+        42);
+
+    {
+        std::string text{ "copied" };
+        ASSERT_TRUE(pubsub.PublishAsync(42, text));
+        ASSERT_TRUE(pubsub.PublishAsync(42, std::string{ "moved" }));
+        ASSERT_TRUE(pubsub.PublishAsync(41, std::string{ "no match" }));
+    }
+    pubsub.Flush();
+    std::multiset<std::string> expected{ "42,copied", "42,moved" };
+    ASSERT_EQ(expected, results);
+    ASSERT_EQ(0U, pubsub.DroppedEvents());
+
+    tbd::PubSub synchronous{};
+    ASSERT_THROW(synchronous.PublishAsync(42), std::runtime_error);
+}
+
+TEST(PubSub, PublishAsyncOverflow)
+{
+    auto run = [](tbd::PubSub::Overflow overflow)
+    {
+        tbd::PubSub pubsub{ tbd::PubSub::Async{ .threads = 1, .capacity = 2, .overflow = overflow } };
+        std::latch started{ 1U };
+        std::latch release{ 1U };
+        std::vector<int> results{};
+        auto anchor = pubsub.Subscribe(
+            [&](int v)
+            {
+                if (v == 1)
+                {
+                    started.count_down();
+                    release.wait();
+                }
+                results.push_back(v);
+            });
+
+        pubsub.PublishAsync(1);
+        started.wait(); // the worker holds the first event, and the queue is empty
+        pubsub.PublishAsync(2);
+        pubsub.PublishAsync(3);
+        auto fourth = std::async(
+            overflow == tbd::PubSub::Overflow::Block ? std::launch::async : std::launch::deferred,
+            [&pubsub] { return pubsub.PublishAsync(4); });
+        if (overflow == tbd::PubSub::Overflow::Block)
+        {
+            EXPECT_EQ(std::future_status::timeout, fourth.wait_for(shortDelay));
+        }
+        else
+        {
+            fourth.wait(); // the queue is still full
+        }
+        release.count_down();
+        auto queued = fourth.get();
+        pubsub.Flush();
+        return std::make_tuple(queued, pubsub.DroppedEvents(), results);
+    };
+
+    ASSERT_EQ(std::make_tuple(true, size_t{ 0 }, std::vector{ 1, 2, 3, 4 }), run(tbd::PubSub::Overflow::Block));
+    ASSERT_EQ(std::make_tuple(false, size_t{ 1 }, std::vector{ 1, 2, 3 }), run(tbd::PubSub::Overflow::DropNewest));
+    ASSERT_EQ(std::make_tuple(true, size_t{ 1 }, std::vector{ 1, 3, 4 }), run(tbd::PubSub::Overflow::DropOldest));
+}
+
+TEST(PubSub, PublishAsyncOutlivesPubSub)
+{
+    // the worker keeps the subscriptions alive while it dispatches, so the
+    // last reference may be dropped on the worker thread
+    std::latch started{ 1U };
+    std::latch release{ 1U };
+    auto token = std::make_shared<int>(42);
+    std::weak_ptr<int> watch{ token };
+    auto pubsub = std::make_unique<tbd::PubSub>(tbd::PubSub::Async{});
+    auto anchor = pubsub->Subscribe(
+        [&started, &release, token = std::move(token)](int)
+        {
+            started.count_down();
+            release.wait();
+        });
+    pubsub->PublishAsync(42);
+    started.wait();
+    pubsub.reset(); // the anchor doesn't keep the subscriptions alive
+    ASSERT_FALSE(watch.expired());
+    release.count_down();
+    for (auto deadline = std::chrono::steady_clock::now() + 1s; !watch.expired();)
+    {
+        ASSERT_LT(std::chrono::steady_clock::now(), deadline);
+        std::this_thread::sleep_for(1ms);
+    }
+}
+
+TEST(PubSub, PublishBatch)
+{
+    // subscriptions made or released by callbacks apply to the rest of the batch
+    tbd::PubSub pubsub{};
+    std::vector<std::string> results{};
+    tbd::PubSub::Anchor child{};
+    auto anchor = pubsub.Subscribe(
+        [&](int, int pid)
+        {
+            results.emplace_back("start:" + std::to_string(pid));
+            child = pubsub.Subscribe(
+                [&](int, int pid)
+                {
+                    results.emplace_back("end:" + std::to_string(pid));
+                    child = nullptr;
+                },
+                2,
+                pid);
+        },
+        1);
+
+    std::vector<std::tuple<int, int>> events{ { 2, 10 }, { 1, 11 }, { 3, 11 }, { 2, 11 }, { 2, 11 }, { 1, 12 } };
+    pubsub.PublishBatch(events);
+    std::vector<std::string> expected{ "start:11", "end:11", "start:12" };
+    ASSERT_EQ(expected, results);
+    results.clear();
+
+    // events which match several subscriptions each
+    std::vector<std::tuple<int, int>> many{};
+    for (int pid{ 100 }; pid < 120; ++pid)
+    {
+        many.emplace_back(4, pid);
+    }
+    int calls{};
+    auto several = pubsub.Subscribe([&calls](int, int) { ++calls; }, 4);
+    several.Add([&calls](int, int) { ++calls; }, 4);
+    several.Add([&calls](int, int) { ++calls; }, tbd::any, tbd::any);
+    pubsub.PublishBatch(many);
+    ASSERT_EQ(60, calls);
+    several = nullptr;
+
+    std::span<const std::tuple<int, int>> batch{ events.data(), 1U };
+    pubsub.PublishBatch(batch.begin(), batch.end());
+    pubsub.PublishBatch(std::span<const std::tuple<int, int>>{});
+    pubsub.PublishBatch(std::vector<std::tuple<int, const char*>>{ { 2, "no subscriptions" } });
+    ASSERT_TRUE(results.empty());
+
+    pubsub.PublishBatch(std::array{ std::tuple{ 2, 12 } });
+    expected = { "end:12" };
+    ASSERT_EQ(expected, results);
+}
+
+TEST(PubSub, StaticPubSub)
+{
+    tbd::StaticPubSub<void(int), void(int, const char*)> pubsub{};
+    std::vector<std::string> results{};
+    auto anchor = pubsub.Subscribe([&results](int v) { results.emplace_back(std::to_string(v)); }, 42)
+                      .Subscribe(
+                          [&results](int v, const char* text) { results.emplace_back(std::to_string(v) + "," + text); },
+                          tbd::any,
+                          std::string{ "text" });
+    ASSERT_EQ(2, pubsub.CallTypes());
+
+    pubsub(41);
+    pubsub(42);
+    pubsub.Publish(1, "text");
+    pubsub.Publish(2, "other");
+
+    // the underlying PubSub shares the same subscriptions
+    pubsub.GetPubSub().Publish(3, "text");
+    std::vector<std::string> expected{ "42", "1,text", "3,text" };
+    ASSERT_EQ(expected, results);
+
+    anchor = nullptr;
+    pubsub(42);
+    ASSERT_EQ(expected, results);
+    ASSERT_EQ(0, pubsub.SubscriptionCount());
+}
+
+TEST(PubSub, StaticPubSubConditions)
+{
+    // the subscriptions are the ordinary ones, so every modifier means what it means to PubSub
+    tbd::StaticPubSub<void(int, unsigned int), void(const char*)> pubsub{ tbd::PubSub{ tbd::removeEmptySets } };
+    std::vector<std::string> results{};
+    auto record = [&results](std::string name)
+    {
+        return [&results, name](int v, unsigned int bits)
+        { results.push_back(name + ":" + std::to_string(v) + "," + std::to_string(bits)); };
+    };
+    auto publish = [&](int v, unsigned int bits)
+    {
+        results.clear();
+        pubsub(v, bits);
+        std::ranges::sort(results); // the groups are matched in no particular order
+        return results;
+    };
+    auto anchor = pubsub.MakeAnchor();
+    anchor.Add(record("one"), 1)
+        .Add(record("big"), 1, tbd::GT{ 10U })
+        .Add(record("ge5"), tbd::GE{ 5 })
+        .Add(record("neg"), tbd::LT{ 0 })
+        .Add(record("bits"), tbd::any, tbd::BitSelect<unsigned int, 6U>{ 2U })
+        .Add(record("all"));
+    ASSERT_EQ(6, pubsub.SelectorCount());
+    ASSERT_EQ(6, pubsub.SubscriptionCount());
+
+    ASSERT_EQ((std::vector<std::string>{ "all:1,0", "one:1,0" }), publish(1, 0U));
+    ASSERT_EQ((std::vector<std::string>{ "all:7,2", "bits:7,2", "ge5:7,2" }), publish(7, 2U));
+    ASSERT_EQ((std::vector<std::string>{ "all:-3,11", "bits:-3,11", "neg:-3,11" }), publish(-3, 11U));
+    ASSERT_EQ((std::vector<std::string>{ "all:1,11", "big:1,11", "bits:1,11", "one:1,11" }), publish(1, 11U));
+
+    // the ordinary PubSub publishes to the same subscriptions
+    results.clear();
+    pubsub.GetPubSub().Publish(5, 0U);
+    std::ranges::sort(results);
+    ASSERT_EQ((std::vector<std::string>{ "all:5,0", "ge5:5,0" }), results);
+
+    // a C string condition compares the pointer, as it does when subscribing through the PubSub
+    static const char* const text = "text";
+    const std::string copy{ text };
+    std::vector<std::string> strings{};
+    auto other = pubsub.Subscribe([&strings](const char* v) { strings.emplace_back(v); }, text);
+    pubsub(copy.c_str());
+    ASSERT_TRUE(strings.empty());
+    pubsub(text);
+    pubsub.GetPubSub().Publish(text);
+    ASSERT_EQ((std::vector<std::string>{ "text", "text" }), strings);
+
+    // emptied groups are removed, and made again by the next subscription
+    anchor = nullptr;
+    other = nullptr;
+    ASSERT_EQ(0, pubsub.SelectorCount());
+    anchor = pubsub.Subscribe(record("again"), 1);
+    ASSERT_EQ((std::vector<std::string>{ "again:1,0" }), publish(1, 0U));
+}
+
+TEST(PubSub, HasSubscribers)
+{
+    tbd::PubSub pubsub{};
+    ASSERT_FALSE((pubsub.HasSubscribers<int, const char*>()));
+
+    auto anchor = pubsub.Subscribe([](int, const char*) {}, 42).Subscribe([](int, const char*) {}, 43);
+    ASSERT_TRUE((pubsub.HasSubscribers<int, const char*>()));
+    ASSERT_TRUE((pubsub.HasSubscribers<const int&, const char*>())) << "the signature is the decayed argument types";
+    ASSERT_FALSE((pubsub.HasSubscribers<int>()));
+
+    tbd::PubSub other{};
+    ASSERT_FALSE((other.HasSubscribers<int, const char*>())) << "each PubSub counts its own subscriptions";
+
+    anchor = nullptr;
+    ASSERT_FALSE((pubsub.HasSubscribers<int, const char*>()));
+}
+
+TEST(PubSub, PublishLazy)
+{
+    tbd::PubSub pubsub{};
+    unsigned int produced{};
+    auto producer = [&produced]
+    {
+        ++produced;
+        return std::tuple{ 42, std::string{ "/proc/42/exe" } };
+    };
+    std::vector<std::string> results{};
+
+    pubsub.PublishLazy<int, std::string_view>(producer);
+    ASSERT_EQ(0U, produced) << "nobody subscribes, so the arguments aren't needed";
+
+    auto anchor = pubsub.Subscribe([&results](int, std::string_view path) { results.emplace_back(path); }, 42);
+    pubsub.PublishLazy<int, std::string_view>(producer);
+    ASSERT_EQ(1U, produced);
+    std::vector<std::string> expected{ "/proc/42/exe" };
+    ASSERT_EQ(expected, results);
+}
+
+TEST(PubSub, OrderedSelectors)
+{
+    // conditions which can't be hashed are kept in sorted blocks, which split
+    // as they fill up
+    struct Version
+    {
+        int v;
+        auto operator<=>(const Version&) const = default;
+    };
+    using Tuple = tbd::helpers::ArgsToTuple<Version>;
+    using Select = std::tuple<const Version>;
+    static_assert(std::is_base_of_v<tbd::PubSub::OrderedGroup<Tuple, Select>, tbd::PubSub::GroupFor<Tuple, Select>>);
+
+    constexpr int versions = 100;
+    tbd::PubSub pubsub{};
+    std::vector<int> calls(versions);
+    std::deque<tbd::PubSub::Anchor> anchors{};
+    for (int i{}; i < 10'000; ++i)
+    {
+        anchors.push_back(pubsub.Subscribe([&calls](Version version) { ++calls[version.v]; }, Version{ i % versions }));
+    }
+    for (size_t i{}; i < anchors.size(); i += 3)
+    {
+        anchors[i] = nullptr;
+    }
+    ASSERT_EQ(6'666, pubsub.SubscriptionCount());
+
+    for (int i{}; i < versions; ++i)
+    {
+        pubsub(Version{ i });
+    }
+    pubsub(Version{ versions });
+    for (int i{}; i < versions; ++i)
+    {
+        auto removed = (i % 3 == 0) ? 34 : 33;
+        ASSERT_EQ(100 - removed, calls[i]) << "version " << i;
+    }
+}
+
+TEST(PubSub, ColumnarSelectors)
+{
+    // scalar conditions which neither hashing nor a single range can index share one
+    // group per call signature, however their conditions are typed
+    enum class Kind : short
+    {
+        Low = -2,
+        Mid = 0,
+        High = 3
+    };
+    using Tuple = tbd::helpers::ArgsToTuple<Kind, int, unsigned int>;
+    using Ranges = std::tuple<const Kind, const tbd::GE<int>, const tbd::LT<unsigned int>>;
+    using Mixed = std::tuple<const tbd::Any_t, const tbd::LE<int>, const tbd::GT<unsigned int>>;
+    static_assert(std::is_base_of_v<tbd::PubSub::ColumnarGroup<Tuple>, tbd::PubSub::GroupFor<Tuple, Ranges>>);
+    static_assert(std::is_same_v<tbd::PubSub::GroupFor<Tuple, Ranges>, tbd::PubSub::GroupFor<Tuple, Mixed>>);
+
+    tbd::PubSub pubsub{};
+    std::multiset<std::string> results{};
+    std::deque<tbd::PubSub::Anchor> anchors{};
+    auto add = [&](std::string name, auto... conditions)
+    {
+        anchors.push_back(pubsub.Subscribe(
+            [&results, name](Kind, int, unsigned int) { results.insert(name); }, conditions...));
+    };
+    add("low-ge-neg", Kind::Low, tbd::GE{ -5 }, tbd::LT{ 10U });
+    add("any-le-neg", tbd::any, tbd::LE{ -5 }, tbd::BitSelect<unsigned int, 06U>{ 02U });
+    add("high-gt", Kind::High, tbd::GT{ 0 }, tbd::any);
+    add("lt-kind", tbd::LT{ Kind::Mid }, tbd::LT{ 0 }, tbd::GE{ 1U });
+    add("never-gt", tbd::any, tbd::GT{ std::numeric_limits<int>::max() }, tbd::any);
+    add("never-lt", tbd::any, tbd::LT{ std::numeric_limits<int>::min() }, tbd::any);
+    add("all-ge", tbd::any, tbd::GE{ std::numeric_limits<int>::min() }, tbd::LE{ ~0U });
+    ASSERT_EQ(7, pubsub.SubscriptionCount());
+
+    pubsub(Kind::Low, -5, 2U);
+    std::multiset<std::string> expected{ "low-ge-neg", "any-le-neg", "lt-kind", "all-ge" };
+    ASSERT_EQ(expected, results);
+    results.clear();
+
+    pubsub(Kind::High, 7, 0U);
+    expected = { "high-gt", "all-ge" };
+    ASSERT_EQ(expected, results);
+    results.clear();
+
+    pubsub(Kind::Mid, std::numeric_limits<int>::max(), 10U);
+    expected = { "all-ge" };
+    ASSERT_EQ(expected, results);
+    results.clear();
+
+    anchors[0] = nullptr;
+    anchors[6] = nullptr;
+    pubsub(Kind::Low, -5, 2U);
+    expected = { "any-le-neg", "lt-kind" };
+    ASSERT_EQ(expected, results);
+    results.clear();
+
+    // rows are removed by moving the last into their place; check every row still matches
+    std::vector<int> calls(100);
+    for (int i{}; i < 100; ++i)
+    {
+        anchors.push_back(pubsub.Subscribe(
+            [&calls, i](Kind, int, unsigned int) { ++calls[i]; }, Kind::Mid, tbd::GE{ i }, tbd::LE{ 1000U }));
+    }
+    for (size_t i{ 7 }; i < anchors.size(); i += 3)
+    {
+        anchors[i] = nullptr;
+    }
+    pubsub(Kind::Mid, 99, 0U);
+    for (int i{}; i < 100; ++i)
+    {
+        ASSERT_EQ(i % 3 == 0 ? 0 : 1, calls[i]) << "rule " << i;
+    }
+}
+
+TEST(PubSub, DiscriminationNetwork)
+{
+    // exact conditions and tbd::any share one tree per call signature, whichever slots are wild
+    enum class Op
+    {
+        Start,
+        Open,
+        Close,
+    };
+    using Tuple = tbd::helpers::ArgsToTuple<Op, int, int, std::string>;
+    using Leading = std::tuple<const tbd::Any_t, const int, const tbd::Any_t, const std::string>;
+    using Trailing = std::tuple<const Op, const tbd::Any_t, const int, const tbd::Any_t>;
+    static_assert(std::is_base_of_v<tbd::PubSub::DiscriminationGroup<Tuple>, tbd::PubSub::GroupFor<Tuple, Leading>>);
+    static_assert(std::is_same_v<tbd::PubSub::GroupFor<Tuple, Leading>, tbd::PubSub::GroupFor<Tuple, Trailing>>);
+
+    struct Rule
+    {
+        std::optional<Op> op;
+        std::optional<int> pid;
+        std::optional<int> fd;
+        std::optional<std::string> path;
+        bool Matches(Op o, int p, int f, const std::string& s) const
+        {
+            return (!op || *op == o) && (!pid || *pid == p) && (!fd || *fd == f) && (!path || *path == s);
+        }
+    };
+    const std::array<std::string, 3> paths{ "/bin/sh", "/etc/passwd", "/tmp/x" };
+    tbd::PubSub pubsub{};
+    std::vector<Rule> rules{};
+    std::vector<int> calls{};
+    std::deque<tbd::PubSub::Anchor> anchors{};
+    for (int i{}; i < 2'000; ++i)
+    {
+        Rule rule{};
+        auto wild = i % 16;
+        auto callback = [&calls, i](Op, int, int, const std::string&) { ++calls[i]; };
+        auto condition = [wild](int slot, auto value) { return (wild >> slot & 1) ? std::nullopt : std::optional{ value }; };
+        rule.op = condition(0, static_cast<Op>(i % 3));
+        rule.pid = condition(1, i % 50);
+        rule.fd = condition(2, i % 7);
+        rule.path = condition(3, paths[i % 3]);
+        auto anchor = pubsub.MakeAnchor();
+        // subscribe with tbd::any in the wild slots, which makes one SelectType for each of the 16 patterns
+        auto any = [](const auto& value) -> std::variant<tbd::Any_t, std::decay_t<decltype(*value)>>
+        {
+            if (value)
+            {
+                return *value;
+            }
+            return tbd::any;
+        };
+        std::visit(
+            [&](const auto&... conditions) { anchor.Add(callback, conditions...); },
+            any(rule.op),
+            any(rule.pid),
+            any(rule.fd),
+            any(rule.path));
+        rules.push_back(rule);
+        anchors.push_back(std::move(anchor));
+    }
+    calls.resize(rules.size());
+    ASSERT_EQ(1, pubsub.GroupCount());
+
+    auto check = [&](const char* when)
+    {
+        for (int event{}; event < 300; ++event)
+        {
+            std::fill(calls.begin(), calls.end(), 0);
+            auto op = static_cast<Op>(event % 3);
+            auto pid = event % 53;
+            auto fd = event % 7;
+            const auto& path = paths[event % 2];
+            pubsub(op, pid, fd, path);
+            for (size_t i{}; i < rules.size(); ++i)
+            {
+                auto expected = anchors[i] && rules[i].Matches(op, pid, fd, path) ? 1 : 0;
+                ASSERT_EQ(expected, calls[i]) << when << " rule " << i << " event " << event;
+            }
+        }
+    };
+    check("all subscribed");
+    for (size_t i{}; i < anchors.size(); i += 3)
+    {
+        anchors[i] = nullptr;
+    }
+    check("a third unsubscribed");
+    for (auto& anchor : anchors)
+    {
+        anchor = nullptr;
+    }
+    ASSERT_EQ(0, pubsub.SubscriptionCount());
+}
+
+TEST(PubSub, MemoryResource)
+{
+    // subscriptions and their anchors come from the given resource, and all of it is returned
+    class Counting : public std::pmr::memory_resource
+    {
+        void* do_allocate(size_t bytes, size_t alignment) override
+        {
+            ++allocations;
+            outstanding += bytes;
+            return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        }
+        void do_deallocate(void* p, size_t bytes, size_t alignment) override
+        {
+            outstanding -= bytes;
+            std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+        }
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+    public:
+        std::atomic<size_t> allocations{};
+        std::atomic<size_t> outstanding{};
+    };
+    Counting resource{};
+    {
+        tbd::PubSub pubsub{ resource };
+        int calls{};
+        auto anchor = pubsub.Subscribe([&calls](int) { ++calls; }, 42);
+        anchor.Add([&calls](int, const char*) { ++calls; });
+        ASSERT_LE(4U, resource.allocations) << "a linker, its control block and two elements";
+        pubsub(42);
+        pubsub(43, "text");
+        ASSERT_EQ(2, calls);
+
+        auto survivor = pubsub.Subscribe([](int) {});
+        anchor = nullptr;
+        ASSERT_NE(0U, resource.outstanding);
+        pubsub = tbd::PubSub{};
+        survivor = nullptr; // the anchor outlived its PubSub, and it still returns its memory
+    }
+    ASSERT_EQ(0U, resource.outstanding);
+}
+
+TEST(PubSub, PublishRealtime)
+{
+    // once the thread's buffer has room, publishing allocates nothing however many subscriptions match
+    tbd::PubSub pubsub{};
+    int calls{};
+    auto anchor = pubsub.MakeAnchor();
+    for (int i{}; i < 100; ++i)
+    {
+        anchor.Add([&calls](int, int) { ++calls; }, i < 3 ? 3 : 4);
+        anchor.Add([&calls](int, int) { ++calls; }, tbd::GE{ 100 });
+    }
+    anchor.Add([&calls](int, int) { ++calls; }, 1, tbd::LT{ 10 });
+    tbd::PubSub::ReserveMatches(200);
+
+    auto publish = [&](int value)
+    {
+        calls = 0;
+        auto allocations = test::ThreadAllocations();
+        pubsub.PublishRealtime(value, 1);
+        return test::ThreadAllocations() - allocations;
+    };
+    ASSERT_EQ(0U, publish(1));
+    ASSERT_EQ(1, calls);
+    ASSERT_EQ(0U, publish(3));
+    ASSERT_EQ(3, calls);
+    ASSERT_EQ(0U, publish(100));
+    ASSERT_EQ(100, calls);
+
+    // nested publishing uses a buffer of its own
+    auto nested = pubsub.Subscribe([&](long) { pubsub.PublishRealtime(100, 1); }, 5L);
+    tbd::PubSub::ReserveMatches(200, 2);
+    calls = 0;
+    auto allocations = test::ThreadAllocations();
+    pubsub.PublishRealtime(5L);
+    ASSERT_EQ(0U, test::ThreadAllocations() - allocations);
+    ASSERT_EQ(100, calls);
+}
+
+TEST(PubSub, DetachAsync)
+{
+    // detaching doesn't wait for a callback in progress on another thread, but stops any more being called
+    std::latch started{ 1U };
+    std::latch release{ 1U };
+    tbd::PubSub pubsub{};
+    std::atomic<int> calls{};
+    auto anchor = pubsub.Subscribe(
+        [&](int)
+        {
+            ++calls;
+            started.count_down();
+            release.wait();
+        },
+        42);
+    anchor.Add([&calls](long) { ++calls; });
+
+    std::thread thr{ [&pubsub] { pubsub.Publish(42); } };
+    started.wait();
+    std::promise<void> done{};
+    auto f = done.get_future();
+    anchor.DetachAsync([&done] { done.set_value(); });
+    ASSERT_FALSE(anchor);
+    pubsub.Publish(42);
+    pubsub.Publish(42L);
+    ASSERT_EQ(1, calls);
+    ASSERT_EQ(std::future_status::timeout, f.wait_for(shortDelay)) << "the callback is still running";
+
+    release.count_down();
+    thr.join();
+    ASSERT_EQ(std::future_status::ready, f.wait_for(1s));
+    ASSERT_EQ(0, pubsub.SubscriptionCount());
+
+    // an empty anchor is done at once, and the callback is released once the detach is done
+    bool emptyDone{};
+    anchor.DetachAsync([&emptyDone] { emptyDone = true; });
+    ASSERT_TRUE(emptyDone);
+    auto token = std::make_shared<int>(42);
+    {
+        tbd::PubSub other{};
+        auto last = other.Subscribe([token](int) {});
+        std::promise<void> detached{};
+        auto d = detached.get_future();
+        last.DetachAsync([&detached] { detached.set_value(); });
+        ASSERT_EQ(std::future_status::ready, d.wait_for(1s));
+    }
+    ASSERT_EQ(1, token.use_count());
+}
+
+TEST(PubSub, Statistics)
+{
+    // the counts are kept as subscriptions come and go, and the breakdown agrees with them
+    tbd::PubSub pubsub{ tbd::removeEmptySets };
+    auto publisher = pubsub.MakePublisher<long>();
+    auto first = pubsub.Subscribe([](int) {}, 42).Subscribe([](int) {}, tbd::GE{ 50 });
+    first.Add([](int, const char*) {});
+    auto second = pubsub.Subscribe([](int) {}, 43);
+    ASSERT_EQ(2, pubsub.CallTypes());
+    ASSERT_EQ(3, pubsub.SelectorCount());
+    ASSERT_EQ(4, pubsub.SubscriptionCount());
+    ASSERT_EQ(2, pubsub.AnchorCount());
+
+    auto signatures = pubsub.Statistics();
+    ASSERT_EQ(3, signatures.size()) << "the publisher's signature is included, though nothing subscribes to it";
+    std::map<std::type_index, size_t> subscriptions{};
+    size_t groups{};
+    for (const auto& stats : signatures)
+    {
+        subscriptions[stats.signature] = stats.subscriptions;
+        groups += stats.groups.size();
+    }
+    ASSERT_EQ(3, subscriptions[typeid(tbd::helpers::ArgsToTuple<int>)]);
+    ASSERT_EQ(1, subscriptions[typeid(tbd::helpers::ArgsToTuple<int, const char*>)]);
+    ASSERT_EQ(0, subscriptions[typeid(tbd::helpers::ArgsToTuple<long>)]);
+    ASSERT_EQ(pubsub.SelectorCount(), groups);
+
+    first = nullptr;
+    ASSERT_EQ(1, pubsub.CallTypes());
+    ASSERT_EQ(1, pubsub.SelectorCount());
+    ASSERT_EQ(1, pubsub.SubscriptionCount());
+    ASSERT_EQ(1, pubsub.AnchorCount());
+    subscriptions.clear();
+    groups = 0;
+    for (const auto& stats : pubsub.Statistics())
+    {
+        subscriptions[stats.signature] = stats.subscriptions;
+        groups += stats.groups.size();
+    }
+    ASSERT_EQ(1, subscriptions[typeid(tbd::helpers::ArgsToTuple<int>)]) << "the emptied groups are gone";
+    ASSERT_EQ(pubsub.SelectorCount(), groups);
+    second = nullptr;
+    ASSERT_EQ(0, pubsub.CallTypes());
+    ASSERT_EQ(0, pubsub.SelectorCount());
+    ASSERT_EQ(0, pubsub.SubscriptionCount());
+    ASSERT_EQ(0, pubsub.AnchorCount());
+}
+
+TEST(PubSub, MetricsCompileAway)
+{
+    // without TBD_PUBSUB_METRICS there is nothing to keep, and nothing is kept
+    static_assert(std::is_empty_v<tbd::PubSub::PrototypeMetrics>);
+    static_assert(std::is_empty_v<tbd::PubSub::GroupMetrics>);
+    static_assert(std::is_empty_v<tbd::PubSub::Stopwatch>);
+    tbd::PubSub pubsub{};
+    auto anchor = pubsub.Subscribe([](int) {});
+    pubsub(42);
+    ASSERT_TRUE(pubsub.Metrics().signatures.empty());
+}
+
+namespace
+{
+    enum class FileEvent
+    {
+        Start,
+        Open,
+        Close,
+        End,
+    };
+
+    /// @brief Follow a file of a process from its opening to its closing, recording each step
+    tbd::PubSub::Chain WatchFile(tbd::PubSub pubsub, int pid, std::vector<std::string>* steps)
+    {
+        auto [open, openPid, fd] = co_await pubsub.Next<FileEvent, int, int>(FileEvent::Open, pid, tbd::any);
+        steps->push_back("open " + std::to_string(fd));
+        auto [close, closePid, closeFd] = co_await pubsub.Next<FileEvent, int, int>(FileEvent::Close, pid, fd);
+        steps->push_back("close " + std::to_string(closeFd));
+    }
+
+    /// @brief Await events from publishing threads for ever, counting those which it didn't wait for
+    tbd::PubSub::Chain CountHandoffs(tbd::PubSub pubsub,
+                                     std::atomic<size_t>* steps,
+                                     std::atomic<size_t>* handoffs,
+                                     std::promise<void>* handedOff)
+    {
+        for (;;)
+        {
+            auto [one, publisher] = co_await pubsub.Next<int, std::thread::id>(1, tbd::any);
+            // a match resumes a waiting coroutine on its own thread, so elsewhere it came while suspending
+            if (publisher != std::this_thread::get_id() && handoffs->fetch_add(1U) == 0U)
+            {
+                handedOff->set_value();
+            }
+            steps->fetch_add(1U);
+            steps->notify_all();
+        }
+    }
+
+    /// @brief Wait for an event which never comes
+    tbd::PubSub::Chain WaitForever(tbd::PubSub pubsub)
+    {
+        co_await pubsub.Next<int, std::thread::id>(2, tbd::any);
+    }
+
+    /// @brief Fail on the first event
+    tbd::PubSub::Chain ThrowOnOpen(tbd::PubSub pubsub)
+    {
+        co_await pubsub.Next<FileEvent>(FileEvent::Open);
+        throw std::runtime_error{ "open" };
+    }
+
+    /// @brief Take a while over the first step, so that the coroutine can be destroyed while it's resumed
+    tbd::PubSub::Chain SlowStep(tbd::PubSub pubsub, std::latch* resumed, std::atomic<bool>* finished)
+    {
+        co_await pubsub.Next<int>(2);
+        resumed->count_down();
+        std::this_thread::sleep_for(shortDelay);
+        finished->store(true);
+        co_await pubsub.Next<int>(3);
+    }
+} // namespace
+
+TEST(PubSub, Next)
+{
+    tbd::PubSub pubsub{};
+    std::vector<std::string> steps{};
+    auto chain = WatchFile(pubsub, 42, &steps);
+    ASSERT_FALSE(chain.Done());
+    ASSERT_EQ(1U, pubsub.WaiterCount()) << "only the step being awaited waits";
+    ASSERT_EQ(0, pubsub.SubscriptionCount()) << "waiting doesn't subscribe";
+
+    pubsub.Publish(FileEvent::Close, 42, 3);
+    pubsub.Publish(FileEvent::Open, 41, 3);
+    ASSERT_TRUE(steps.empty());
+    pubsub.Publish(FileEvent::Open, 42, 3);
+    ASSERT_EQ(std::vector<std::string>{ "open 3" }, steps);
+    ASSERT_EQ(1U, pubsub.WaiterCount()) << "the first step was replaced by the second";
+    pubsub.Publish(FileEvent::Open, 42, 4);
+    pubsub.Publish(FileEvent::Close, 42, 4);
+    ASSERT_EQ(1U, steps.size()) << "each step is only resumed once, and by its own conditions";
+    pubsub.Publish(FileEvent::Close, 42, 3);
+    ASSERT_EQ((std::vector<std::string>{ "open 3", "close 3" }), steps);
+    ASSERT_TRUE(chain.Done());
+    ASSERT_EQ(0U, pubsub.WaiterCount());
+
+    // destroying a waiting coroutine stops its wait
+    steps.clear();
+    chain = WatchFile(pubsub, 43, &steps);
+    ASSERT_EQ(1U, pubsub.WaiterCount());
+    chain = {};
+    ASSERT_EQ(0U, pubsub.WaiterCount());
+    pubsub.Publish(FileEvent::Open, 43, 3);
+    ASSERT_TRUE(steps.empty());
+
+    // the coroutine resumes on the publishing thread
+    chain = WatchFile(pubsub, 44, &steps);
+    std::thread{ [&pubsub] { pubsub.Publish(FileEvent::Open, 44, 5); } }.join();
+    std::thread{ [&pubsub] { pubsub.Publish(FileEvent::Close, 44, 5); } }.join();
+    ASSERT_EQ((std::vector<std::string>{ "open 5", "close 5" }), steps);
+    ASSERT_TRUE(chain.Done());
+}
+
+TEST(PubSub, NextHandoff)
+{
+    // a match which comes while the coroutine is suspending continues it on the suspending thread
+    tbd::PubSub pubsub{};
+    std::atomic<size_t> steps{};
+    std::atomic<size_t> handoffs{};
+    std::promise<void> handedOff{};
+    auto handedOffFuture = handedOff.get_future();
+    // another waiter keeps the publishers busy with the waiters, which suspending then contends for
+    auto idle = WaitForever(pubsub);
+    std::vector<std::jthread> publishers{};
+    for (int p{}; p < 2; ++p)
+    {
+        publishers.emplace_back(
+            [&pubsub](std::stop_token stop)
+            {
+                while (!stop.stop_requested())
+                {
+                    pubsub.Publish(1, std::this_thread::get_id());
+                }
+            });
+    }
+    auto chain = CountHandoffs(pubsub, &steps, &handoffs, &handedOff);
+    ASSERT_EQ(std::future_status::ready, handedOffFuture.wait_for(10s)) << "after " << steps << " steps";
+
+    // cancelling from this thread while the publishers resume the coroutine
+    chain = {};
+    ASSERT_EQ(1U, pubsub.WaiterCount());
+    for (int i{}; i < 10; ++i)
+    {
+        auto before = steps.load();
+        chain = CountHandoffs(pubsub, &steps, &handoffs, &handedOff);
+        steps.wait(before);
+        chain = {};
+    }
+    ASSERT_EQ(1U, pubsub.WaiterCount());
+    ASSERT_EQ(0, pubsub.SubscriptionCount()) << "waiting doesn't subscribe";
+    publishers.clear();
+    idle = {};
+    ASSERT_EQ(0U, pubsub.WaiterCount());
+    ASSERT_FALSE((pubsub.HasSubscribers<int, std::thread::id>()));
+}
+
+TEST(PubSub, NextCancelWhileResuming)
+{
+    // destroying a coroutine which another thread is resuming waits for it to suspend
+    tbd::PubSub pubsub{};
+    std::latch resumed{ 1 };
+    std::atomic<bool> finished{};
+    auto chain = SlowStep(pubsub, &resumed, &finished);
+    std::thread publisher{ [&pubsub] { pubsub.Publish(2); } };
+    resumed.wait();
+    chain = {};
+    ASSERT_TRUE(finished);
+    ASSERT_EQ(0U, pubsub.WaiterCount());
+    publisher.join();
+    pubsub.Publish(3);
+}
+
+TEST(PubSub, NextException)
+{
+    // an exception which escapes a chain is kept for its owner, not thrown into the publisher
+    tbd::PubSub pubsub{};
+    auto chain = ThrowOnOpen(pubsub);
+    ASSERT_NO_THROW(chain.Rethrow());
+    ASSERT_NO_THROW(pubsub.Publish(FileEvent::Open));
+    ASSERT_TRUE(chain.Done());
+    ASSERT_THROW(chain.Rethrow(), std::runtime_error);
+    ASSERT_EQ(0U, pubsub.WaiterCount());
+}
+
+TEST(PubSub, Sequence)
+{
+    // a process which writes a file and closes it, correlated on the pid and then on the fd too
+    tbd::PubSub pubsub{};
+    constexpr tbd::Var<0> pid{};
+    constexpr tbd::Var<1> fd{};
+    auto sequence = pubsub.MakeSequence<int, int>();
+    sequence.Then<FileEvent, int>(FileEvent::Start, pid)
+        .Then<FileEvent, int, int, unsigned int>(FileEvent::Open, pid, fd, tbd::BitSelect<unsigned int, 2U>{ 2U })
+        .Then<FileEvent, int, int>(FileEvent::Close, pid, fd)
+        .Then<FileEvent, int>(FileEvent::End, pid);
+    std::vector<std::pair<int, int>> found{};
+    auto anchor = sequence.Compile([&found](int pid, int fd) { found.emplace_back(pid, fd); });
+    ASSERT_EQ(4, pubsub.SubscriptionCount()) << "one subscription for each step";
+
+    pubsub.Publish(FileEvent::Open, 1, 3, 2U);
+    pubsub.Publish(FileEvent::Start, 1);
+    pubsub.Publish(FileEvent::Start, 2);
+    ASSERT_EQ(2U, sequence.PartialMatches());
+    pubsub.Publish(FileEvent::Open, 1, 3, 1U); // read only
+    pubsub.Publish(FileEvent::Open, 1, 4, 3U);
+    pubsub.Publish(FileEvent::Open, 2, 5, 2U);
+    pubsub.Publish(FileEvent::Close, 1, 5);    // another process's fd
+    pubsub.Publish(FileEvent::Close, 2, 5);
+    pubsub.Publish(FileEvent::End, 1);
+    ASSERT_TRUE(found.empty());
+    pubsub.Publish(FileEvent::Close, 1, 4);
+    pubsub.Publish(FileEvent::End, 2);
+    pubsub.Publish(FileEvent::End, 1);
+    ASSERT_EQ((std::vector<std::pair<int, int>>{ { 2, 5 }, { 1, 4 } }), found);
+    ASSERT_EQ(0U, sequence.PartialMatches());
+    ASSERT_EQ(4, pubsub.SubscriptionCount()) << "runs don't subscribe";
+
+    // every run waiting for an event moves on with it
+    pubsub.Publish(FileEvent::Start, 7);
+    pubsub.Publish(FileEvent::Start, 7);
+    pubsub.Publish(FileEvent::Open, 7, 3, 2U);
+    pubsub.Publish(FileEvent::Close, 7, 3);
+    pubsub.Publish(FileEvent::End, 7);
+    ASSERT_EQ(4U, found.size());
+
+    pubsub.Publish(FileEvent::Start, 8);
+    anchor = {};
+    ASSERT_EQ(0, pubsub.SubscriptionCount());
+    pubsub.Publish(FileEvent::Open, 8, 3, 2U);
+}
+
+TEST(PubSub, SequenceRepeatedStep)
+{
+    // an event which matches consecutive steps only takes a run through one of them
+    tbd::PubSub pubsub{};
+    constexpr tbd::Var<0> pid{};
+    auto sequence = pubsub.MakeSequence<int>();
+    sequence.Then<int, int>(1, pid).Then<int, int>(1, pid).Then<int, int>(tbd::any, pid);
+    std::vector<int> found{};
+    auto anchor = sequence.Compile([&found](int pid) { found.push_back(pid); });
+
+    pubsub.Publish(1, 5);
+    ASSERT_TRUE(found.empty());
+    ASSERT_EQ(1U, sequence.PartialMatches());
+    pubsub.Publish(1, 5);
+    ASSERT_TRUE(found.empty());
+    ASSERT_EQ(2U, sequence.PartialMatches()) << "one run at each step";
+    pubsub.Publish(1, 5);
+    ASSERT_EQ((std::vector<int>{ 5 }), found);
+    ASSERT_EQ(2U, sequence.PartialMatches());
+
+    // each event in a batch is an event of its own
+    found.clear();
+    pubsub.PublishBatch(std::vector<std::tuple<int, int>>{ { 1, 6 }, { 1, 6 }, { 2, 6 } });
+    ASSERT_EQ((std::vector<int>{ 6 }), found);
+}